@@ -0,0 +1,31 @@
+// Byte stuffing kernels header.
+
+#ifndef _BYTE_STUFFING_H_
+#define _BYTE_STUFFING_H_
+
+// Frame delimiter and escape octet used by the link layer.
+#define FLAG 0x7E
+#define ESCAPE_OCTET 0x7D
+#define ESCAPE_XOR 0x20
+
+// Worst case size of numBytes bytes after byte stuffing (every byte escaped).
+#define STUFFED_SIZE(numBytes) (2 * (numBytes))
+
+// Byte stuffing of buf into out, which must have room for STUFFED_SIZE(bufSize) bytes.
+// The XOR of the original bytes (BCC2) is computed in the same pass and stored in bcc2.
+// Returns the number of bytes written to out.
+int stuffBytes(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2);
+
+// Byte destuffing of buf into out, which must have room for bufSize bytes.
+// The XOR of the destuffed bytes is computed in the same pass and stored in bcc2.
+// Returns the number of bytes written to out, or -1 if buf ends with an escape octet.
+int destuffBytes(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2);
+
+// Portable versions of the kernels above (used when SSE2/AVX2 are not available).
+int stuffBytesScalar(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2);
+int destuffBytesScalar(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2);
+
+// Name of the kernel selected for this CPU ("avx2", "sse2" or "scalar").
+const char *byteStuffingKernel();
+
+#endif // _BYTE_STUFFING_H_
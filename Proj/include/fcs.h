@@ -0,0 +1,49 @@
+// Frame check sequence header.
+// BCC2 is the XOR of the data (1 byte, the original frame format).
+// CRC-16 is the HDLC FCS-16 (CRC-16/X-25: CCITT polynomial, reflected, 0xFFFF init and final XOR).
+// CRC-32C uses the Castagnoli polynomial (reflected, 0xFFFFFFFF init and final XOR).
+
+#ifndef _FCS_H_
+#define _FCS_H_
+
+#include <sys/uio.h>
+
+typedef enum
+{
+    FCS_BCC2,
+    FCS_CRC16,
+    FCS_CRC32C,
+    FCS_NONE,   // No check (FEC frames are checked by the link layer once corrected)
+} FcsType;
+
+// Largest frame check sequence (CRC-32C).
+#define FCS_MAX_SIZE 4
+
+// Number of bytes of the frame check sequence of a given type.
+int fcsSize(FcsType type);
+
+// Compute the frame check sequence of buf and store it in fcs (least significant byte first).
+void computeFcs(FcsType type, const unsigned char *buf, int bufSize, unsigned char *fcs);
+
+// Same as computeFcs, over the concatenation of iovcnt buffers.
+void computeFcsv(FcsType type, const struct iovec *iov, int iovcnt, unsigned char *fcs);
+
+// CRC-16/X-25 of buf (slicing-by-8).
+unsigned short crc16(const unsigned char *buf, int bufSize);
+
+// CRC-16/X-25 of data that continues after earlier data whose CRC is crc (0 for none).
+unsigned short crc16Update(unsigned short crc, const unsigned char *buf, int bufSize);
+
+// CRC-32C of buf (CRC32 instruction when the CPU has SSE4.2, slicing-by-8 otherwise).
+unsigned int crc32c(const unsigned char *buf, int bufSize);
+
+// CRC-32C of data that continues after earlier data whose CRC is crc (0 for none).
+unsigned int crc32cUpdate(unsigned int crc, const unsigned char *buf, int bufSize);
+
+// Portable CRC-32C (slicing-by-8), the same function crc32c uses without SSE4.2.
+unsigned int crc32cSlicingBy8(const unsigned char *buf, int bufSize);
+
+// Name of the CRC-32C kernel selected for this CPU ("sse4.2" or "slicing-by-8").
+const char *crcKernel();
+
+#endif // _FCS_H_
@@ -0,0 +1,23 @@
+// Forward error correction header.
+// Reed-Solomon over GF(256): the data is split in blocks of up to 255 - paritySize bytes and
+// each block gets paritySize parity bytes, so up to paritySize / 2 wrong bytes per block are
+// corrected. The encoded field is the data followed by the parity of every block.
+
+#ifndef _FEC_H_
+#define _FEC_H_
+
+// Largest number of parity bytes per block.
+#define FEC_MAX_PARITY 64
+
+// Number of bytes of dataSize bytes of data once the parity is added.
+int fecEncodedSize(int dataSize, int paritySize);
+
+// Compute the parity of data and store it in parity (fecEncodedSize(dataSize, paritySize) - dataSize bytes).
+// Returns the number of parity bytes written, or -1 if paritySize is not supported.
+int fecEncode(const unsigned char *data, int dataSize, int paritySize, unsigned char *parity);
+
+// Correct the data of an encoded field in place, corrected is set to the number of bytes fixed.
+// Returns the number of data bytes, or -1 if a block has more errors than can be corrected.
+int fecDecode(unsigned char *encoded, int encodedSize, int paritySize, int *corrected);
+
+#endif // _FEC_H_
@@ -0,0 +1,77 @@
+// Frame parser header.
+// Table driven state machine shared by every frame reader of the link layer.
+
+#ifndef _FRAME_PARSER_H_
+#define _FRAME_PARSER_H_
+
+#include "fcs.h"
+
+// Address field
+#define ADDRESS_SENT_BY_TX 0x03 // or replies sent by receiver.
+#define ADDRESS_SENT_BY_RX 0x01 // or replies sent by transmitter.
+
+typedef enum
+{
+    FRAME_NONE,     // No complete frame yet
+    FRAME_SU,       // Supervision / Unnumbered frame (F A C BCC1 F)
+    FRAME_I,        // Information frame with a valid FCS (F A C BCC1 D1..DN FCS F)
+    FRAME_BAD_BCC1, // Header with an invalid BCC1 (frame is discarded)
+    FRAME_BAD_BCC2, // Information frame with an invalid FCS (or longer than the output, reported as soon as it overflows)
+} FrameEventType;
+
+typedef struct
+{
+    FrameEventType type;
+    unsigned char address;
+    unsigned char control;
+    unsigned char *data; // FRAME_I: destuffed data (without the FCS), in the parser output
+                         // FRAME_BAD_BCC2: the same, unchecked (NULL if the frame was too long)
+    int size;            // FRAME_I, FRAME_BAD_BCC2: number of data bytes
+} FrameEvent;
+
+typedef struct
+{
+    int state;
+    int expected;           // Byte value that moves the current state forward (BCC1), -1 when unused
+    unsigned char address;
+    unsigned char control;
+    unsigned char *out;     // Destuffed data field of the current frame
+    int outSize;
+    int outCapacity;
+    unsigned char *target;  // Output used from the next frame on
+    int targetCapacity;
+    int escape;             // Last data byte was an escape octet
+    unsigned char bcc;      // XOR of the destuffed bytes (data + BCC2)
+    unsigned char spill[FCS_MAX_SIZE]; // Bytes past the output capacity (FCS of a full data field)
+    int spilled;
+    FcsType fcsType;
+    int fcsSize;
+    int overflow;
+    unsigned char *data;    // Default output
+    int dataCapacity;
+} FrameParser;
+
+// Allocate the default output for information frames with up to maxDataSize data bytes.
+// Returns -1 on error.
+int initFrameParser(FrameParser *parser, int maxDataSize);
+
+// Release the default output.
+void freeFrameParser(FrameParser *parser);
+
+// Drop any partially received frame.
+void resetFrameParser(FrameParser *parser);
+
+// Destuff the data field of the following I frames straight into out (up to capacity bytes,
+// longer frames are rejected). NULL goes back to the default output.
+// Takes effect from the next frame, so it can be changed between parseFrameBytes calls.
+void setFrameParserOutput(FrameParser *parser, unsigned char *out, int capacity);
+
+// Frame check sequence of the following I frames (FCS_BCC2 after initFrameParser).
+void setFrameParserFcs(FrameParser *parser, FcsType type);
+
+// Consume up to numBytes bytes, stopping right after the first complete frame event.
+// event->type is FRAME_NONE if every byte was consumed without completing a frame.
+// Returns the number of bytes consumed.
+int parseFrameBytes(FrameParser *parser, const unsigned char *bytes, int numBytes, FrameEvent *event);
+
+#endif // _FRAME_PARSER_H_
@@ -0,0 +1,81 @@
+// io_uring serial port header.
+// The reads and writes of a serial port go through an io_uring instead of read(), write() and poll():
+// a read is always in flight into the receive buffer, checking whether it completed costs no
+// system call, and waiting for bytes or for the next timer is a single io_uring_enter().
+// Writes are copied to a staging buffer and go out in order, one write in flight at a time
+// (the bytes written meanwhile are sent together by the next one).
+// The ring is set up with the raw system calls (no liburing). openIoRing fails on kernels without
+// io_uring (or with it disabled) and the caller keeps the poll backend.
+
+#ifndef _IO_RING_H_
+#define _IO_RING_H_
+
+#include <stddef.h>
+#include <termios.h>
+
+// Size of the write staging buffer (must be a power of two, larger than the biggest frame).
+#define IO_RING_WRITE_SIZE 32768
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+typedef struct
+{
+    int fd;     // io_uring instance (readable while completions wait to be reaped)
+    int portFd; // Serial port, non-blocking while the ring uses it
+    int portFlags;
+    struct termios portSettings;
+
+    // Submission and completion queues (shared with the kernel)
+    void *rings;
+    size_t ringsSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+
+    // Read in flight
+    int reading;
+    int readResult; // Bytes of the completed read not returned yet (-1 if there is none)
+
+    // Write staging buffer (free running counters: head is the first byte not written yet)
+    unsigned char writeBuffer[IO_RING_WRITE_SIZE];
+    unsigned int writeHead;
+    unsigned int writeTail;
+    int writing;      // Bytes of the write in flight (0 if there is none)
+    int writeQueued;  // The write is not submitted yet
+    int error;   // errno of a read or write that failed (the ring can not be used any more)
+} IoRing;
+
+// Set up a ring for the serial port portFd. Until closeIoRing the port is non-blocking with VMIN 1, so a read
+// with no bytes to return waits in the kernel instead of completing empty.
+// Returns -1 if io_uring can not be used (nothing is changed), 0 otherwise.
+int openIoRing(IoRing *ring, int portFd);
+
+// Wait until every byte written went out, cancel the read in flight and free the ring.
+// Returns -1 if a write failed, 0 otherwise.
+int closeIoRing(IoRing *ring);
+
+// Start a read of up to maxBytes into buf unless one is in flight, then return the bytes of the read in
+// flight once it completes. Waits at most timeoutMs milliseconds (0 does not wait, -1 waits forever),
+// any completion ends the wait. buf must not be used until the read returned its bytes.
+// A new read is only submitted by the next call that waits (or by a write), so checking for bytes
+// without waiting never costs a system call.
+// Returns -1 on error, otherwise the number of bytes read (0 if the read did not complete yet).
+int ioRingRead(IoRing *ring, unsigned char *buf, int maxBytes, int timeoutMs);
+
+// Submit the requests that are queued but not submitted yet (no system call if there are none),
+// so the read in flight completes while the caller waits on something else.
+// Returns -1 on error, 0 otherwise.
+int ioRingSubmit(IoRing *ring);
+
+// Return 1 if a read is in flight (its buffer belongs to the kernel), 0 otherwise.
+int ioRingReading(const IoRing *ring);
+
+// Queue numBytes to be written to the serial port after the bytes queued before them
+// (waits only while the staging buffer is full).
+// Returns -1 on error, otherwise numBytes.
+int ioRingWrite(IoRing *ring, const unsigned char *bytes, int numBytes);
+
+#endif // _IO_RING_H_
@@ -0,0 +1,130 @@
+// Link layer extensions header.
+// Functions of the link layer that are not part of the interface in link_layer.h.
+
+#ifndef _LINK_LAYER_EXT_H_
+#define _LINK_LAYER_EXT_H_
+
+#include "link_layer.h"
+
+#include <sys/uio.h>
+
+// Payload size (in bytes) the next llwrite should use for the best goodput.
+// It follows the error rate measured by tx and never exceeds MAX_PAYLOAD_SIZE.
+int llpayloadSize();
+
+// Same as llwrite, with the data of the frame gathered from iovcnt buffers (for instance a packet
+// header and the file data after it), so the caller never copies them into one packet.
+// Return number of chars written, or "-1" on error.
+int llwritev(const struct iovec *iov, int iovcnt);
+
+// Send numPackets packets, one frame each, as soon as the window has room for them.
+// Packet i is gathered from the iovcnt[i] buffers of iov that follow the ones of packet i - 1.
+// Return number of packets written, or "-1" on error.
+int llwriteBatch(const struct iovec *iov, const int iovcnt[], int numPackets);
+
+// Frames encoded ahead of time
+// llencode does the byte stuffing, FCS and FEC of a frame without sending it, and llwriteEncoded sends it
+// later (same as llwritev). llencode only reads the parameters of the session, so another thread may encode
+// the next frames while llwriteEncoded waits for the window. The window sends the frame (and sends it again)
+// from the buffer it was encoded into, which stays untouched until llunacknowledged says it was acknowledged.
+// Size of the buffer llencode needs (the largest encoded frame of the session), or "-1" on error.
+int llencodedSize();
+
+// Encode a frame with the data gathered from iovcnt buffers into frame (llencodedSize bytes).
+// Return number of bytes of the encoded frame, or "-1" on error.
+int llencode(const struct iovec *iov, int iovcnt, unsigned char *frame);
+
+// Send a frame of frameSize bytes encoded by llencode, carrying dataSize data bytes (its header is written into frame).
+// Return number of chars written (dataSize), or "-1" on error.
+int llwriteEncoded(unsigned char *frame, int frameSize, int dataSize);
+
+// Number of frames sent and not acknowledged yet, the most recent ones (frames are acknowledged in order).
+// Returns -1 on error.
+int llunacknowledged();
+
+// Receive the next packet and then the packets that already arrived, up to maxPackets (only the
+// first one is waited for). packets holds one buffer per packet, sizes gets the size of each one.
+// Return number of packets read, or "-1" on error.
+int llreadBatch(unsigned char *packets[], int sizes[], int maxPackets);
+
+// Number of data packets llread can return without waiting (duplex sessions, 0 otherwise).
+// Frames that arrive while an end only writes wait in a small queue, an application that
+// writes and reads at once should empty it between llwrite calls.
+// Returns -1 on error.
+int llreadAvailable();
+
+// Connection handles
+// The functions above (and the ones in link_layer.h) drive a single link. The ones below take
+// the connection they work on, so one process can open any number of serial ports at once.
+// Connections share nothing: each one may be used by a different thread, but a connection
+// must not be used by two threads at the same time.
+typedef struct LinkConnection LinkConnection;
+
+// Open a connection using the "port" parameters defined in struct linkLayer.
+// Return the connection, or NULL on error.
+LinkConnection *ll_open(LinkLayer connectionParameters);
+
+// Send data in buf with size bufSize.
+// Return number of chars written, or "-1" on error.
+int ll_write(LinkConnection *conn, const unsigned char *buf, int bufSize);
+
+// Same as llwritev and llwriteBatch, for a connection.
+int ll_writev(LinkConnection *conn, const struct iovec *iov, int iovcnt);
+int ll_writeBatch(LinkConnection *conn, const struct iovec *iov, const int iovcnt[], int numPackets);
+
+// Same as llencodedSize, llencode, llwriteEncoded and llunacknowledged, for a connection (ll_encode may run on another thread).
+int ll_encodedSize(LinkConnection *conn);
+int ll_encode(LinkConnection *conn, const struct iovec *iov, int iovcnt, unsigned char *frame);
+int ll_writeEncoded(LinkConnection *conn, unsigned char *frame, int frameSize, int dataSize);
+int ll_unacknowledged(LinkConnection *conn);
+
+// Receive data in packet.
+// Return number of chars read, or "-1" on error.
+int ll_read(LinkConnection *conn, unsigned char *packet);
+
+// Same as llreadBatch, llpayloadSize and llreadAvailable, for a connection.
+int ll_readBatch(LinkConnection *conn, unsigned char *packets[], int sizes[], int maxPackets);
+int ll_payloadSize(LinkConnection *conn);
+int ll_readAvailable(LinkConnection *conn);
+
+// Asynchronous interface
+// Requests are queued and return right away, ll_poll does the work of the link and calls the callback
+// of every request it completes, in the order they were submitted. A single thread can then drive any
+// number of connections (and its own file I/O) from one event loop, waiting on the fd of ll_eventFd.
+// Blocking calls must not be used while requests are queued. ll_close drains the window as before,
+// requests still queued are dropped without their callbacks.
+
+// Called when a request completes: result is the number of data bytes written or read, "-1" if
+// the link failed (every queued request then completes with "-1").
+typedef void (*LinkCallback)(LinkConnection *conn, int result, void *arg);
+
+// Queue a frame with the bufSize bytes of buf (tx, or both ends in duplex). It is sent once the window
+// has room for it, buf must stay valid until the callback (callback may be NULL).
+// Return "0", or "-1" if the request is invalid or the queue is full.
+int ll_submitWrite(LinkConnection *conn, const unsigned char *buf, int bufSize, LinkCallback callback, void *arg);
+
+// Queue a read of the next packet into packet (rx, or both ends in duplex), which must stay valid
+// until the callback. Rx leaves the frames in the serial port while no read is queued.
+// Return "0", or "-1" if the request is invalid or the queue is full.
+int ll_submitRead(LinkConnection *conn, unsigned char *packet, LinkCallback callback, void *arg);
+
+// Handle the frames and timers of the link and complete the requests that can be, waiting up to
+// timeoutMs milliseconds for at least one of them (0 never waits, -1 waits as long as it takes).
+// Returns at once when no request is queued, the link still needs ll_poll while frames wait for
+// their acknowledgement (the event fd tells when).
+// Return number of requests completed, or "-1" on error.
+int ll_poll(LinkConnection *conn, int timeoutMs);
+
+// File descriptor that is readable whenever ll_poll has work to do (an epoll fd watching the serial
+// port, its io_uring if it has one and the timers of the connection), for an event loop that waits
+// on several sources at once.
+// It belongs to the connection and is closed by ll_close.
+// Return the file descriptor, or "-1" on error.
+int ll_eventFd(LinkConnection *conn);
+
+// Close a connection and free it (whatever the result, conn must not be used afterwards).
+// if showStatistics == TRUE, link layer should print statistics in the console on close.
+// Return "1" on success or "-1" on error.
+int ll_close(LinkConnection *conn, int showStatistics);
+
+#endif // _LINK_LAYER_EXT_H_
@@ -0,0 +1,57 @@
+// Link parameter negotiation header.
+// tx offers its parameters in the data field of the SET, rx picks the session parameters
+// from the offer and its own and sends them back in the UA. Parameters are TLV coded
+// (type, length, value, most significant byte first), unknown types are skipped.
+// A plain SET or UA (without data) comes from an old peer, which only knows the original
+// protocol: stop-and-wait, BCC2, no FEC.
+
+#ifndef _NEGOTIATION_H_
+#define _NEGOTIATION_H_
+
+#include "fcs.h"
+
+// Parameter types
+#define PARAM_ARQ 0x01         // Preferred ARQ mode, accepted ARQ modes (bit mask)
+#define PARAM_WINDOW 0x02      // Largest window size
+#define PARAM_MAX_PAYLOAD 0x03 // Largest payload size (2 bytes)
+#define PARAM_FCS 0x04         // Preferred FCS type, accepted FCS types (bit mask)
+#define PARAM_FEC 0x05         // Reed-Solomon parity bytes per block (0 without FEC)
+#define PARAM_DUPLEX 0x06      // Both ends send I frames (1) or only tx does (0)
+#define PARAM_CHECKPOINT 0x07  // Tx polls (RR with P) before it retransmits, rx answers with F (1) or not (0)
+
+// Largest encoded parameter list.
+#define MAX_PARAMETERS_SIZE 32
+
+typedef struct
+{
+    int arqMode;     // Preferred ARQ mode (0 stop-and-wait, 1 Go-Back-N, 2 Selective Repeat)
+    int arqModes;    // Accepted ARQ modes, bit n for mode n (stop-and-wait is always accepted)
+    int windowSize;
+    int maxPayload;
+    FcsType fcsType; // Preferred FCS type
+    int fcsTypes;    // Accepted FCS types, bit n for type n (BCC2 is always accepted)
+    int fecParity;
+    int duplex;      // Needs the modulo-8 control fields (not stop-and-wait)
+    int checkpoint;  // Poll / Final
+} LinkParameters;
+
+// Parameters of the original protocol (used with old peers).
+void legacyParameters(LinkParameters *params);
+
+// Write the parameters into buf (at least MAX_PARAMETERS_SIZE bytes).
+// Returns the number of bytes written.
+int encodeParameters(const LinkParameters *params, unsigned char *buf);
+
+// Read the parameters from buf, the ones that are missing keep their legacy value.
+// Returns -1 if the list is malformed, 0 otherwise.
+int decodeParameters(const unsigned char *buf, int size, LinkParameters *params);
+
+// Session parameters for the offer of tx and the parameters of rx: the preferred option of tx
+// if rx accepts it (the best one both accept otherwise) and the smallest sizes.
+// Every option of the session is the only accepted one, so the session can be sent back as is.
+void negotiateParameters(const LinkParameters *offer, const LinkParameters *local, LinkParameters *session);
+
+// Returns 1 if the session parameters sent back by rx fit in the offer of tx, 0 otherwise.
+int acceptSession(const LinkParameters *offer, const LinkParameters *session);
+
+#endif // _NEGOTIATION_H_
@@ -0,0 +1,46 @@
+// Adaptive payload size header.
+// The bit error rate p is estimated from the outcome of every I frame sent (acknowledged,
+// or rejected / timed out), recent frames weighing more. The payload size L that maximizes
+// the expected goodput L / (L + H) * (1 - p)^(8 (L + H)) for an overhead of H bytes per frame is
+//   L = (sqrt(H^2 + 4 H / a) - H) / 2, with a = -8 ln(1 - p) (about 8 p)
+// (all of the payload when no errors were seen).
+// With a window of one frame the time spent waiting for each response counts as overhead too.
+
+#ifndef _PAYLOAD_SIZE_H_
+#define _PAYLOAD_SIZE_H_
+
+// Number of size ranges in the report of the payload sizes sent.
+#define PAYLOAD_REPORT_BUCKETS 10
+
+typedef struct
+{
+    double errors;   // Frames lost to errors (weighted)
+    double bits;     // Bits sent (weighted)
+    int overhead;    // Bytes sent per frame besides the payload (header, FCS, flag and response)
+    double idle;     // Bytes the link could have carried while waiting for each response (smoothed)
+    int minSize;
+    int maxSize;
+    int size;        // Payload size that currently gives the best goodput
+    unsigned long sent[PAYLOAD_REPORT_BUCKETS]; // Frames sent per size range
+    unsigned long numFrames;
+    unsigned long totalBytes;
+    int smallest;
+    int largest;
+} PayloadSizer;
+
+// Start with the largest payload until errors are seen.
+void initPayloadSizer(PayloadSizer *sizer, int minSize, int maxSize, int overhead);
+
+// Update the bit error rate estimate with the outcome of a frame of frameSize bytes on the wire.
+void payloadSample(PayloadSizer *sizer, int frameSize, int errored);
+
+// Update the time spent waiting for a response, in bytes the link could have carried meanwhile.
+void payloadIdleSample(PayloadSizer *sizer, double idleBytes);
+
+// Count a frame with a payload of size bytes in the report.
+void recordPayloadSize(PayloadSizer *sizer, int size);
+
+// Print how many frames were sent with each payload size.
+void printPayloadReport(const PayloadSizer *sizer);
+
+#endif // _PAYLOAD_SIZE_H_
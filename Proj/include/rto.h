@@ -0,0 +1,28 @@
+// Retransmission timeout estimator header.
+// Jacobson/Karels: smoothed round trip time and its variation give the timeout,
+// which is doubled on every timeout until a new round trip time is measured.
+
+#ifndef _RTO_H_
+#define _RTO_H_
+
+typedef struct
+{
+    double srtt;    // Smoothed round trip time (ms)
+    double rttvar;  // Round trip time variation (ms)
+    double rto;     // Retransmission timeout (ms)
+    double minRto;
+    double maxRto;
+    int numSamples;
+} RtoEstimator;
+
+// Start with the maximum timeout until the first round trip time is measured.
+void initRtoEstimator(RtoEstimator *estimator, double minRto, double maxRto);
+
+// Update the timeout with a measured round trip time (ms).
+// Only frames that were sent once may be measured (Karn's algorithm).
+void rtoSample(RtoEstimator *estimator, double rtt);
+
+// Double the timeout after a timeout (up to the maximum).
+void rtoBackoff(RtoEstimator *estimator);
+
+#endif // _RTO_H_
@@ -0,0 +1,44 @@
+// Buffered serial port reader header.
+// Bytes are read from the serial port in chunks into a receive ring buffer,
+// so a whole frame usually costs a single read() call instead of one per byte.
+// Every serial port read this way has its own buffer.
+// With an io_uring (see io_ring.h) the kernel reads into the buffer instead of read() and poll().
+
+#ifndef _SERIAL_BUFFER_H_
+#define _SERIAL_BUFFER_H_
+
+#include "io_ring.h"
+
+// Size of the receive ring buffer (must be a power of two).
+#define READ_BUFFER_SIZE 4096
+
+typedef struct
+{
+    int fd; // Serial port the bytes are read from
+    unsigned char ring[READ_BUFFER_SIZE];
+    unsigned int head; // Next byte to be returned
+    unsigned int tail; // Where the next read() stores bytes
+    IoRing *ioRing;    // Reads through this ring instead of read() (NULL by default)
+} ReadBuffer;
+
+// Read up to maxBytes received from the serial port into buf.
+// Waits at most timeoutMs milliseconds for the first byte (0 does not wait, -1 waits forever).
+// Returns -1 on error, otherwise the number of bytes read (0 if none arrived in time).
+int readBytes(ReadBuffer *buffer, unsigned char *buf, int maxBytes, int timeoutMs);
+
+// Point bytes at the received bytes without removing them from the buffer
+// (reading from the serial port first if the buffer is empty, as readBytes does).
+// Only contiguous bytes are returned, the rest are returned by the next call.
+// Returns -1 on error, otherwise the number of bytes available at *bytes.
+int peekBytes(ReadBuffer *buffer, const unsigned char **bytes, int timeoutMs);
+
+// Remove numBytes bytes returned by peekBytes from the buffer.
+void consumeBytes(ReadBuffer *buffer, int numBytes);
+
+// Drop every buffered byte and read from fd from now on (must be called when the serial port is opened).
+void resetReadBuffer(ReadBuffer *buffer, int fd);
+
+// Read the serial port through ring (opened for its fd) from now on, or with read() again if ring is NULL.
+void readThroughRing(ReadBuffer *buffer, IoRing *ring);
+
+#endif // _SERIAL_BUFFER_H_
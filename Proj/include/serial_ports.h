@@ -0,0 +1,29 @@
+// Serial ports header.
+// A process that drives several links has a serial port per link, the functions of serial_port.h
+// use a single one. These open, close and write any number of ports through them.
+
+#ifndef _SERIAL_PORTS_H_
+#define _SERIAL_PORTS_H_
+
+#include <termios.h>
+
+typedef struct
+{
+    int fd;                // File descriptor of the open serial port
+    struct termios oldtio; // Settings to restore on closing
+} SerialPort;
+
+// Open and configure a serial port (as openSerialPort does).
+// Returns -1 on error, otherwise the file descriptor.
+int openPort(SerialPort *port, const char *serialPort, int baudRate);
+
+// Restore the original settings of a serial port and close it (as closeSerialPort does).
+// Returns -1 on error.
+int closePort(SerialPort *port);
+
+// Write up to numBytes to a serial port (must check how many were actually
+// written in the return value).
+// Returns -1 on error, otherwise the number of bytes written.
+int writePort(SerialPort *port, const char *bytes, int numBytes);
+
+#endif // _SERIAL_PORTS_H_
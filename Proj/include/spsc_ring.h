@@ -0,0 +1,71 @@
+// Single-producer single-consumer ring header.
+// A bounded queue of fixed size slots between two threads: one fills slots and publishes them,
+// the other takes them in the same order and releases them. Neither side takes a lock, a slot
+// changes hands by moving a free running counter (release / acquire), so while the ring is neither
+// full nor empty no system call is made. A side that must wait (ring full or empty) sleeps on a
+// semaphore the other side only posts when it knows someone sleeps.
+// The consumer may also take a slot before it releases it: the slot is done with (the next peek returns
+// the one after it) but keeps its contents until it is released, oldest first. The producer can be kept
+// only a few slots ahead of the consumer, however many taken slots wait to be released.
+// The memory of the ring is allocated once, numSlots * slotSize bytes.
+
+#ifndef _SPSC_RING_H_
+#define _SPSC_RING_H_
+
+#include <semaphore.h>
+
+typedef struct
+{
+    unsigned char *slots;
+    int slotSize;
+    unsigned int numSlots;
+    unsigned int head;  // Next slot to release (moved by the consumer)
+    unsigned int taken; // Next slot to take (moved by the consumer), between head and tail
+    unsigned int tail;  // Next slot to fill (moved by the producer)
+    unsigned int maxAhead; // Published slots not taken yet the producer may keep
+    int aborted;       // Set by spscAbort, every wait returns NULL afterwards
+
+    // Sleeping sides (a flag that the other side clears when it posts)
+    int producerWaiting;
+    int consumerWaiting;
+    sem_t producerWake;
+    sem_t consumerWake;
+} SpscRing;
+
+// Allocate a ring of numSlots slots of slotSize bytes each (every slot aligned for any type).
+// Returns -1 on error, 0 otherwise.
+int initSpscRing(SpscRing *ring, int numSlots, int slotSize);
+
+// Free the memory of the ring (neither side may use it any more).
+void freeSpscRing(SpscRing *ring);
+
+// Make the producer wait while maxAhead published slots are not taken yet (numSlots by default).
+// Called before either side uses the ring.
+void spscLimitAhead(SpscRing *ring, unsigned int maxAhead);
+
+// Producer: return the next free slot, waiting while the ring is full (or maxAhead slots are not taken
+// yet), or NULL once the ring is aborted.
+// The slot belongs to the producer until spscPublish.
+void *spscReserve(SpscRing *ring);
+
+// Producer: hand the slot of the last spscReserve to the consumer.
+void spscPublish(SpscRing *ring);
+
+// Consumer: return the oldest published slot not taken yet, waiting while there is none, or NULL once the
+// ring is aborted. The slot stays the same (and keeps its contents) until spscRelease.
+void *spscPeek(SpscRing *ring);
+
+// Consumer: return the published slot that follows the one of spscPeek by n (0 is that one), or NULL
+// if it is not published yet (never waits). The slots up to it stay the same until they are released.
+void *spscPeekAhead(SpscRing *ring, unsigned int n);
+
+// Consumer: take the slot of spscPeek, it keeps its contents until it is released.
+void spscTake(SpscRing *ring);
+
+// Consumer: give the oldest published slot back to the producer (taking it first if it is not taken yet).
+void spscRelease(SpscRing *ring);
+
+// Make every wait of both sides return NULL from now on (the other side gave up), waking the sleeping side.
+void spscAbort(SpscRing *ring);
+
+#endif // _SPSC_RING_H_
@@ -0,0 +1,60 @@
+// Timers header.
+// Every running timer has a deadline on the monotonic clock (nanosecond resolution).
+// A single timerfd is armed for the earliest deadline, so waiting for the serial port
+// and for any number of timers is one poll() call and no signals are involved.
+// Each connection has its own set of timers (and timerfd), sets never share timers.
+
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <time.h>
+
+struct TimerSet;
+
+typedef struct Timer
+{
+    struct timespec deadline;
+    int running;
+    struct Timer *next;   // List of running timers
+    struct TimerSet *set; // Set the timer runs in (while running)
+} Timer;
+
+typedef struct TimerSet
+{
+    int timerFd;
+    Timer *runningTimers;
+} TimerSet;
+
+// Create the timerfd of a set (must be called before the other functions).
+// Returns -1 on error, 0 otherwise.
+int openTimers(TimerSet *set);
+
+// Stop every timer of the set and close its timerfd.
+void closeTimers(TimerSet *set);
+
+// Start (or restart) a timer of the set that expires ms milliseconds from now.
+void startTimer(TimerSet *set, Timer *timer, double ms);
+
+// Stop a timer, it does not expire until it is started again.
+void stopTimer(Timer *timer);
+
+// Returns 1 if the timer is running and its deadline passed (until it is stopped or restarted), 0 otherwise.
+int timerExpired(const Timer *timer);
+
+// Arm the timerfd for the earliest deadline of the set, for an event loop that waits on it itself.
+// Returns -1 on error, 0 otherwise.
+int armTimers(TimerSet *set);
+
+// Clear the expiration count once the timerfd was readable (nothing happens if it was not).
+// Returns -1 on error, 0 otherwise.
+int clearTimers(TimerSet *set);
+
+// Milliseconds until the earliest deadline of the set (rounded up, 0 if a timer already expired).
+// Returns -1 if no timer is running.
+int msUntilNextTimer(const TimerSet *set);
+
+// Wait until fd has bytes to read or a running timer of the set expires (returns right away if one already expired).
+// Returns -1 on error, 0 otherwise.
+int waitForEvents(TimerSet *set, int fd);
+
+#endif // _TIMER_H_
@@ -6,9 +6,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
 
 #include "application_layer.h"
 #include "link_layer.h"
+#include "link_layer_ext.h"
+#include "spsc_ring.h"
 
 // Definitions for Control Packets
 #define CtrlPacketStart 1
@@ -17,11 +21,20 @@
 #define CSTART 1
 #define CDATA 2
 #define CEND 3
+#define CSTRIPE 4
 
 // Definitions for Data Packets
-#define partitionSize 996
+#define dataPacketHeaderSize 4 // C, sequence number, L2 and L1
+#define BATCH_SIZE 4 // Data packets written to the file at once
+#define PIPELINE_DEPTH 16 // Frames of the tx pipeline: the ones the link did not acknowledge yet and the ones encoded ahead
+#define ENCODE_AHEAD 1 // Frames tx encodes ahead of the link (a frame is sized once the one before it was sent)
+#define RX_QUEUE_DEPTH 16 // Data packets rx keeps while they wait for the file
 unsigned char sequenceNumber = 0;  // Between 0 and 99
 
+// Definitions for striped transfers (one file over several serial ports)
+#define stripeHeaderSize 7 // C, file offset (4 bytes), L2 and L1
+#define MAX_STRIPE_LINKS 8
+
 
 /**
  * Creates a control packet (start or end)
@@ -91,55 +104,35 @@ unsigned char* createControlPacket(unsigned char* controlPacket, int* currentSiz
 
 /**
  * Creates a data packet according to the specification
- * dataPacket[] - data packet array to be written
- * currentSize - size of the data packet to be written
+ * The header and the data are kept apart, llwritev sends them as one packet without copying them together.
+ * header - array with room for dataPacketHeaderSize bytes
+ * data - array with room for the data (MAX_PAYLOAD_SIZE - dataPacketHeaderSize bytes)
+ * dataSize - number of bytes of data read from the file
  * fd - file descriptor
+ * payloadSize - size of the packet (the link layer picks the size that suits the link best)
  * returns 1 on success
  *         0 if no bytes are read (nothing left to read)
  *        -1 on error
 */
-int createDataPacket(unsigned char* dataPacket[], int* currentSize, int* fd) {
-    unsigned int accumulatorOfBytesRead = 0;
-    unsigned char byte = 0x00;
-
-    (*dataPacket)[0] = CDATA; // Control Data
-
-    // Sequence Number
-    (*currentSize)++;
-    (*dataPacket) = (unsigned char*)realloc((*dataPacket), (*currentSize) * sizeof(unsigned char));
-    (*dataPacket)[(*currentSize) - 1] = sequenceNumber;
-
-    // L2
-    (*currentSize)++;
-    (*dataPacket) = (unsigned char*)realloc((*dataPacket), (*currentSize) * sizeof(unsigned char));
-    (*dataPacket)[(*currentSize) - 1] = 0x00;
-
-    // L1
-    (*currentSize)++;
-    (*dataPacket) = (unsigned char*)realloc((*dataPacket), (*currentSize) * sizeof(unsigned char));
-    (*dataPacket)[(*currentSize) - 1] = 0x00;
-    
-    // Need to subdivide the file into smaller parts (Each packet has data with partitionSize bytes)
-    for (int i = 0; i < partitionSize; i++) {
-        int readBytes = read((*fd), &byte, 1);
+int createDataPacket(unsigned char* header, unsigned char* data, int* dataSize, int* fd, int payloadSize) {
+    // Need to subdivide the file into smaller parts
+    int partitionSize = payloadSize - dataPacketHeaderSize;
+    int accumulatorOfBytesRead = 0;
+    while (accumulatorOfBytesRead < partitionSize) {
+        int readBytes = read((*fd), data + accumulatorOfBytesRead, partitionSize - accumulatorOfBytesRead);
         if (readBytes == -1) return -1;
         if (readBytes == 0) break;
-
-        accumulatorOfBytesRead++;
- 
-        (*currentSize)++;
-        (*dataPacket) = (unsigned char*)realloc((*dataPacket), (*currentSize) * sizeof(unsigned char));
-        (*dataPacket)[(*currentSize) - 1] = byte;
+        accumulatorOfBytesRead += readBytes;
     }
 
-    // K = 256 * L2 + L1
-    int L2 = accumulatorOfBytesRead / 256;
-    int L1 = accumulatorOfBytesRead - (L2 * 256);
-
-    if (L2 == 0 && L1 == 0) return 0;
+    if (accumulatorOfBytesRead == 0) return 0;
 
-    (*dataPacket)[2] = L2;
-    (*dataPacket)[3] = L1;
+    // K = 256 * L2 + L1
+    header[0] = CDATA; // Control Data
+    header[1] = sequenceNumber;
+    header[2] = accumulatorOfBytesRead / 256;
+    header[3] = accumulatorOfBytesRead % 256;
+    (*dataSize) = accumulatorOfBytesRead;
 
     return 1;
 }
@@ -160,6 +153,58 @@ int llwriteWrapper(unsigned char* packet, int sizeOfPacket) {
 }
 
 
+/**
+ * Data packet encoded ahead of time, one slot of the transmitter pipeline
+*/
+typedef struct {
+    int size;     // Bytes of the encoded frame, 0 after the last packet, -1 if the file could not be read
+    int dataSize; // Bytes of the data packet it carries
+    unsigned char frame[];
+} EncodedPacket;
+
+/**
+ * Transmitter pipeline: a thread reads the file and encodes the data packets (byte stuffing, FCS
+ * and FEC) while the link thread sends the ones before them and handles their acknowledgements.
+ * The link sends each frame from its slot (and sends it again from there), the slot is released once
+ * the frame is acknowledged.
+*/
+typedef struct {
+    int fd;
+    SpscRing packets;
+    int payloadSize; // Set by the link thread, it follows the error rate of the link
+} TxPipeline;
+
+
+/**
+ * Reads and encodes the data packets of the file until the end of the file (or an error)
+ * The packet after the last one has size 0 (or -1 if the file could not be read).
+*/
+void* encodeDataPackets(void* arg) {
+    TxPipeline* pipeline = (TxPipeline*)arg;
+    unsigned char header[dataPacketHeaderSize];
+    unsigned char data[MAX_PAYLOAD_SIZE];
+
+    while (TRUE) {
+        EncodedPacket* packet = (EncodedPacket*)spscReserve(&pipeline->packets);
+        if (packet == NULL) break; // The link failed
+
+        int sizeOfData = 0;
+        int payloadSize = __atomic_load_n(&pipeline->payloadSize, __ATOMIC_RELAXED);
+        int created = createDataPacket(header, data, &sizeOfData, &pipeline->fd, payloadSize);
+        if (created == 1) {
+            struct iovec dataPacket[2] = {{header, dataPacketHeaderSize}, {data, sizeOfData}};
+            packet->size = llencode(dataPacket, 2, packet->frame);
+            packet->dataSize = dataPacketHeaderSize + sizeOfData;
+            sequenceNumber = sequenceNumber == (unsigned char)99 ? 0 : sequenceNumber + 1;
+        }
+        else packet->size = created; // 0 at the end of the file, -1 on error
+        spscPublish(&pipeline->packets);
+        if (packet->size <= 0) break;
+    }
+    return NULL;
+}
+
+
 /**
  * Main application function for transmitter.
  * linkStruct - struct that contains information about the transmitter
@@ -209,38 +254,49 @@ int txApplication(LinkLayer linkStruct, const char* filename) {
         return 0;
     }
 
-    // Create data packet
-    int shouldCreateDataPacket = TRUE;
-    while (shouldCreateDataPacket) {
-        unsigned char* dataPacket = (unsigned char*)malloc(sizeof(unsigned char));
-        int sizeOfDataPacket = 1;
-        shouldCreateDataPacket = createDataPacket(&dataPacket, &sizeOfDataPacket, &fd);
+    // Another thread reads and encodes the data packets (up to ENCODE_AHEAD ahead) while this one sends them
+    TxPipeline pipeline = {.fd = fd, .payloadSize = llpayloadSize()};
+    if (initSpscRing(&pipeline.packets, PIPELINE_DEPTH, sizeof(EncodedPacket) + llencodedSize()) == -1) {
+        printf("%s: An error occurred in malloc.\n", __func__);
+        return -1;
+    }
+    spscLimitAhead(&pipeline.packets, ENCODE_AHEAD);
+    pthread_t encoder;
+    if (pthread_create(&encoder, NULL, encodeDataPackets, &pipeline) != 0) {
+        printf("%s: Unable to start the encoder thread.\n", __func__);
+        return -1;
+    }
 
-        if (shouldCreateDataPacket == 0) { // Nothing left to send
-            free(dataPacket);
-            break;
-        }
+    // Send the data packets as the encoder thread hands them over
+    int sendFailed = FALSE;
+    int sentFromRing = 0; // Frames sent from slots that are not released yet
+    while (TRUE) {
+        EncodedPacket* packet = (EncodedPacket*)spscPeek(&pipeline.packets);
+        if (packet->size == 0) break; // Nothing left to send
 
-        if (dataPacket == NULL || shouldCreateDataPacket == -1) {
+        if (packet->size == -1) {
             printf("%s: An error occurred while trying to create the Data Packet\n", __func__);
-            return -1;
-        }
-
-        // Send the data packet
-        if ((bytesWritten = llwriteWrapper(dataPacket, sizeOfDataPacket)) == -1) {
-            printf("%s: An error occurred while trying to send the START Control Packet.\n", __func__);
-            return -1;
+            sendFailed = TRUE;
+            break;
         }
 
-
-        if (bytesWritten == 0) {
-            return 0;
+        if (llwriteEncoded(packet->frame, packet->size, packet->dataSize) == -1) {
+            printf("%s: An error occurred while trying to send the Data Packets.\n", __func__);
+            spscAbort(&pipeline.packets);
+            sendFailed = TRUE;
+            break;
         }
-
-        sequenceNumber = sequenceNumber == (unsigned char)99 ? 0 : sequenceNumber + 1;
-
-        free(dataPacket);
+        // The size of the next packet follows what the link measured so far (as with llwrite), it is set
+        // before the encoder may take a new slot
+        __atomic_store_n(&pipeline.payloadSize, llpayloadSize(), __ATOMIC_RELAXED);
+        spscTake(&pipeline.packets);
+        sentFromRing++;
+
+        // The frames that are still unacknowledged are the last ones sent
+        for (int unacknowledged = llunacknowledged(); sentFromRing > unacknowledged; sentFromRing--) spscRelease(&pipeline.packets);
     }
+    pthread_join(encoder, NULL);
+    if (sendFailed) return -1; // The window still holds frames of the ring, it is not freed
     
     // Create the the end control packet
     controlPacket = createControlPacket(controlPacket, &sizeOfControlPacket, CEND, fileSize, filename);
@@ -261,8 +317,10 @@ int txApplication(LinkLayer linkStruct, const char* filename) {
 
     free(controlPacket);
 
-    // Close connection
-    if (llclose(TRUE) == -1) {
+    // Close connection (the window holds no frame of the ring afterwards, whatever the result)
+    int closed = llclose(TRUE);
+    freeSpscRing(&pipeline.packets);
+    if (closed == -1) {
         printf("%s: An error occurred in llclose.\n", __func__);
         return -1;
     }
@@ -272,20 +330,12 @@ int txApplication(LinkLayer linkStruct, const char* filename) {
 
 
 /**
- * Reads and Checks control packets. 
+ * Checks a control packet that was already read.
  * fileSize - size of the file to be read
  * returns 0 on success
  *        -1 on error
 */
-int readControlPacket(unsigned char* controlPacket, long* fileSize, unsigned char* filename, int type) {
-    if (type != CEND) {
-        int bytesRead = llread(controlPacket);
-        if (bytesRead == -1){
-            printf("%s: Error in llread\n", __func__);
-            return -1;
-        }
-    }
-
+int parseControlPacket(unsigned char* controlPacket, long* fileSize, unsigned char* filename, int type) {
     // Check if the control packet is correct
     if ((controlPacket[0]) != type) {
         printf("%s: Error in controlPacketType\n", __func__);
@@ -332,8 +382,6 @@ int readControlPacket(unsigned char* controlPacket, long* fileSize, unsigned cha
     offset++;
     int filenameSize = controlPacket[offset];
 
-    filename = (unsigned char*)realloc(filename, filenameSize * sizeof(unsigned char));
-
     if (filenameSize < 1) {
         printf("%s: Error in controlPacket, filenameSize is less than one\n", __func__);
         return -1;
@@ -350,8 +398,82 @@ int readControlPacket(unsigned char* controlPacket, long* fileSize, unsigned cha
 }
 
 
+/**
+ * Reads and Checks control packets. 
+ * fileSize - size of the file to be read
+ * returns 0 on success
+ *        -1 on error
+*/
+int readControlPacket(unsigned char* controlPacket, long* fileSize, unsigned char* filename, int type) {
+    if (type != CEND) {
+        int bytesRead = llread(controlPacket);
+        if (bytesRead == -1){
+            printf("%s: Error in llread\n", __func__);
+            return -1;
+        }
+    }
+    return parseControlPacket(controlPacket, fileSize, filename, type);
+}
+
+
+/**
+ * Data packet waiting to be written to the file, one slot of the receiver queue
+*/
+typedef struct {
+    int size; // Bytes of data, 0 after the last packet
+    unsigned char packet[MAX_PAYLOAD_SIZE];
+} ReceivedPacket;
+
+/**
+ * Receiver queue: the data of the packets goes to the file on another thread, so the link layer
+ * acknowledges a frame as soon as it is checked, however long the file takes. Once RX_QUEUE_DEPTH
+ * packets wait for the file, llread is not called until one of them is written.
+*/
+typedef struct {
+    int fd;
+    SpscRing packets;
+    int failed; // The file could not be written
+} RxPipeline;
+
+
+/**
+ * Writes the data of the packets to the file until the packet after the last one (or an error)
+ * The packets that are already waiting go to the file in a single writev, up to BATCH_SIZE.
+*/
+void* writeDataPackets(void* arg) {
+    RxPipeline* pipeline = (RxPipeline*)arg;
+
+    while (TRUE) {
+        if (spscPeek(&pipeline->packets) == NULL) break; // The link failed
+
+        struct iovec fileData[BATCH_SIZE];
+        int numParts = 0;
+        int endReached = FALSE;
+        ReceivedPacket* received;
+        while (numParts < BATCH_SIZE && (received = (ReceivedPacket*)spscPeekAhead(&pipeline->packets, numParts)) != NULL) {
+            if (received->size == 0) {
+                endReached = TRUE;
+                break;
+            }
+            fileData[numParts++] = (struct iovec){received->packet + dataPacketHeaderSize, received->size};
+        }
+
+        if (numParts > 0 && writev(pipeline->fd, fileData, numParts) == -1) {
+            printf("%s: An error occurred while writing to the file.\n", __func__);
+            pipeline->failed = TRUE;
+            spscAbort(&pipeline->packets);
+            break;
+        }
+        for (int i = 0; i < numParts; i++) spscRelease(&pipeline->packets);
+        if (endReached) break;
+    }
+    return NULL;
+}
+
+
 /**
  * Reads, checks a data packet and writes contents to a new file.
+ * Each packet is read straight into the receiver queue, another thread writes it to the file.
  * fd - file descriptor of the new file
  * fileSize - size of the new file
  * fileName - name of the received file
@@ -359,34 +481,48 @@ int readControlPacket(unsigned char* controlPacket, long* fileSize, unsigned cha
  *        -1 on error
 */
 int readDataPacket(int* fd, long* fileSize, unsigned char* fileName) {
-    int continueReadingBytes = 1;
-    long totalAmountRead = 0;
-    while (continueReadingBytes){
-        unsigned char* dataPacket = (unsigned char*)malloc(MAX_PAYLOAD_SIZE * sizeof(unsigned char));
-        int readBytes = 0;
+    RxPipeline pipeline = {.fd = (*fd), .failed = FALSE};
+    if (initSpscRing(&pipeline.packets, RX_QUEUE_DEPTH, sizeof(ReceivedPacket)) == -1) {
+        printf("%s: An error occurred in malloc.\n", __func__);
+        return -1;
+    }
+    pthread_t writer;
+    if (pthread_create(&writer, NULL, writeDataPackets, &pipeline) != 0) {
+        printf("%s: Unable to start the writer thread.\n", __func__);
+        freeSpscRing(&pipeline.packets);
+        return -1;
+    }
 
-        readBytes = llread(dataPacket);
+    long totalAmountRead = 0;
+    int readFailed = FALSE;
+    while (TRUE) {
+        ReceivedPacket* received = (ReceivedPacket*)spscReserve(&pipeline.packets);
+        if (received == NULL) break; // The writer failed
 
-        if (readBytes == 0) continue; // Nothing left to read
+        unsigned char* dataPacket = received->packet;
+        int readBytes = llread(dataPacket);
         if (readBytes == -1) {
             printf("%s: An error occurred in llread.\n", __func__);
-            return -1;
+            readFailed = TRUE;
+            break;
         }
+        if (readBytes == 0) continue; // Nothing left to read
 
         if (dataPacket[0] == CEND){
             if (readControlPacket(dataPacket, fileSize, fileName, CEND) != 0) {
                 printf("%s: Error in readControlPacket.\n", __func__);
-                return -1;
+                readFailed = TRUE;
             }
-            return 0;
+            break;
         }
 
         totalAmountRead += readBytes - 4; // Remove the bytes for header.
- 
+
         // Sequence number check.       
         if (dataPacket[1] != sequenceNumber){
             printf("%s: Unknown error occurred, malformed data packet, sequence number invalid\n", __func__);
-            return -1;
+            readFailed = TRUE;
+            break;
         }
 
         sequenceNumber = sequenceNumber == (unsigned char)99 ? 0 : sequenceNumber + 1;
@@ -395,18 +531,22 @@ int readDataPacket(int* fd, long* fileSize, unsigned char* fileName) {
         int l2 = dataPacket[2];
         int k = 256 * l2 + l1;
 
-        if (k == 0 && dataPacket[0] == CDATA) return 0;
-
-        int bytesWritten = 0;
-        bytesWritten = write((*fd), dataPacket + 4, k);
-
-        if (bytesWritten == -1) {
-            printf("%s: An error occurred while writing to the file.\n", __func__);
-            return -1;
-        }
+        if (k == 0 && dataPacket[0] == CDATA) break;
+        received->size = k;
+        spscPublish(&pipeline.packets);
+    }
 
-        free(dataPacket);
+    // The packets before the end are written too (the slot that was not used marks the end)
+    ReceivedPacket* end = readFailed ? NULL : (ReceivedPacket*)spscReserve(&pipeline.packets);
+    if (end != NULL) {
+        end->size = 0;
+        spscPublish(&pipeline.packets);
     }
+    else spscAbort(&pipeline.packets);
+    pthread_join(writer, NULL);
+    freeSpscRing(&pipeline.packets);
+
+    if (readFailed || pipeline.failed) return -1;
     return totalAmountRead;
 }
 
@@ -427,7 +567,7 @@ int rxApplication(LinkLayer linkStruct, const char* filename) {
     // Read the start control packet
     unsigned char* controlPacket = (unsigned char*)malloc(MAX_PAYLOAD_SIZE * sizeof(unsigned char));
     long fileSize;
-    unsigned char* txFileName = (unsigned char*)malloc(sizeof(unsigned char));
+    unsigned char* txFileName = (unsigned char*)malloc(256 * sizeof(unsigned char)); // Filename length is a single byte (+1 for '\0')
     if (readControlPacket(controlPacket, &fileSize, txFileName, CSTART) != 0) { 
         printf("%s: Error in readControlPacket.\n", __func__);
         return -1;
@@ -461,6 +601,228 @@ int rxApplication(LinkLayer linkStruct, const char* filename) {
 }
 
 
+/**
+ * One member link of a striped transfer.
+ * Every member has its own connection and thread, and takes the next part of the file when it
+ * is ready for it: a slow or noisy link simply carries fewer packets.
+*/
+typedef struct {
+    LinkLayer linkStruct;
+    int fd; // File shared by all the members
+    long* nextOffset; // Next part of the file to send (tx) or bytes written so far (rx)
+    long fileSize;
+    const char* filename;
+    int failed;
+} StripeMember;
+
+
+/**
+ * Creates a striped data packet, with the file offset of the data instead of a sequence number
+ * dataPacket - array with room for the packet
+ * offset - file offset of the data
+ * size - number of bytes of data (already in dataPacket + stripeHeaderSize)
+ * returns the size of the packet
+*/
+int createStripePacket(unsigned char* dataPacket, long offset, int size) {
+    dataPacket[0] = CSTRIPE;
+    dataPacket[1] = (offset >> 24) & 0xFF;
+    dataPacket[2] = (offset >> 16) & 0xFF;
+    dataPacket[3] = (offset >> 8) & 0xFF;
+    dataPacket[4] = offset & 0xFF;
+    dataPacket[5] = size / 256;
+    dataPacket[6] = size % 256;
+    return size + stripeHeaderSize;
+}
+
+
+/**
+ * Sends parts of the file over one member link until there is nothing left to send.
+ * Each member sends the start and end control packets on its own link.
+*/
+void* txStripeMember(void* arg) {
+    StripeMember* member = (StripeMember*)arg;
+    member->failed = 1;
+
+    LinkConnection* conn = ll_open(member->linkStruct);
+    if (conn == NULL) {
+        printf("%s: An error occurred while opening %s.\n", __func__, member->linkStruct.serialPort);
+        return NULL;
+    }
+
+    unsigned char* controlPacket = (unsigned char*)malloc(sizeof(unsigned char));
+    int sizeOfControlPacket = 1;
+    controlPacket = createControlPacket(controlPacket, &sizeOfControlPacket, CSTART, member->fileSize, (const unsigned char*)member->filename);
+    unsigned char* dataPacket = (unsigned char*)malloc(MAX_PAYLOAD_SIZE * sizeof(unsigned char));
+    int ok = controlPacket != NULL && dataPacket != NULL && ll_write(conn, controlPacket, sizeOfControlPacket) == sizeOfControlPacket;
+
+    while (ok) {
+        // Claim the next part of the file, sized for this link
+        int size = ll_payloadSize(conn) - stripeHeaderSize;
+        long offset = __sync_fetch_and_add(member->nextOffset, size);
+        if (offset >= member->fileSize) break;
+        if (size > member->fileSize - offset) size = member->fileSize - offset;
+
+        if (pread(member->fd, dataPacket + stripeHeaderSize, size, offset) != size) {
+            printf("%s: An error occurred while reading the file.\n", __func__);
+            ok = 0;
+            break;
+        }
+
+        int sizeOfDataPacket = createStripePacket(dataPacket, offset, size);
+        if (ll_write(conn, dataPacket, sizeOfDataPacket) != sizeOfDataPacket) {
+            printf("%s: An error occurred while sending over %s.\n", __func__, member->linkStruct.serialPort);
+            ok = 0;
+        }
+    }
+
+    if (ok) {
+        controlPacket = createControlPacket(controlPacket, &sizeOfControlPacket, CEND, member->fileSize, (const unsigned char*)member->filename);
+        ok = ll_write(conn, controlPacket, sizeOfControlPacket) == sizeOfControlPacket;
+    }
+
+    free(controlPacket);
+    free(dataPacket);
+    if (ll_close(conn, TRUE) == 1 && ok) member->failed = 0;
+    return NULL;
+}
+
+
+/**
+ * Writes the parts of the file that arrive over one member link until its end control packet.
+*/
+void* rxStripeMember(void* arg) {
+    StripeMember* member = (StripeMember*)arg;
+    member->failed = 1;
+
+    LinkConnection* conn = ll_open(member->linkStruct);
+    if (conn == NULL) {
+        printf("%s: An error occurred while opening %s.\n", __func__, member->linkStruct.serialPort);
+        return NULL;
+    }
+
+    unsigned char* dataPacket = (unsigned char*)malloc(MAX_PAYLOAD_SIZE * sizeof(unsigned char));
+    unsigned char txFileName[256]; // Filename length is a single byte (+1 for '\0')
+    long fileSize = 0;
+    int ok = dataPacket != NULL;
+
+    // Start control packet
+    int readBytes = ok ? ll_read(conn, dataPacket) : -1;
+    if (readBytes <= 0 || parseControlPacket(dataPacket, &fileSize, txFileName, CSTART) != 0) ok = 0;
+
+    while (ok) {
+        readBytes = ll_read(conn, dataPacket);
+        if (readBytes == 0) continue;
+        if (readBytes < stripeHeaderSize) {
+            printf("%s: An error occurred in llread.\n", __func__);
+            ok = 0;
+            break;
+        }
+
+        if (dataPacket[0] == CEND) {
+            ok = parseControlPacket(dataPacket, &fileSize, txFileName, CEND) == 0;
+            break;
+        }
+
+        long offset = ((long)dataPacket[1] << 24) | (dataPacket[2] << 16) | (dataPacket[3] << 8) | dataPacket[4];
+        int k = 256 * dataPacket[5] + dataPacket[6];
+        if (dataPacket[0] != CSTRIPE || k != readBytes - stripeHeaderSize || offset + k > fileSize) {
+            printf("%s: Unknown error occurred, malformed data packet\n", __func__);
+            ok = 0;
+            break;
+        }
+
+        if (pwrite(member->fd, dataPacket + stripeHeaderSize, k, offset) != k) {
+            printf("%s: An error occurred while writing to the file.\n", __func__);
+            ok = 0;
+            break;
+        }
+        __sync_fetch_and_add(member->nextOffset, k);
+    }
+
+    member->fileSize = fileSize;
+    free(dataPacket);
+    if (ll_close(conn, TRUE) == 1 && ok) member->failed = 0;
+    return NULL;
+}
+
+
+/**
+ * Runs a striped transfer: one member per serial port in the comma separated list serialPorts.
+ * linkStruct - parameters shared by all the member links
+ * serialPorts - serial port paths, separated by commas
+ * filename - name of the file to be sent or received
+ * returns 0 on success
+ *        -1 on error
+*/
+int stripeApplication(LinkLayer linkStruct, const char* serialPorts, const char* filename) {
+    StripeMember members[MAX_STRIPE_LINKS];
+    pthread_t threads[MAX_STRIPE_LINKS];
+    long nextOffset = 0;
+    long fileSize = 0;
+
+    int fd;
+    if (linkStruct.role == LlTx) {
+        fd = open(filename, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) == -1) {
+            printf("Unable to open file.\n");
+            return -1;
+        }
+        fileSize = st.st_size;
+    } else {
+        // Parts arrive in any order, so they are written at their offset (no O_APPEND)
+        fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            printf("Unable to open file.\n");
+            return -1;
+        }
+    }
+
+    int numMembers = 0;
+    const char* port = serialPorts;
+    while (*port != '\0' && numMembers < MAX_STRIPE_LINKS) {
+        int length = strcspn(port, ",");
+        StripeMember* member = &members[numMembers];
+        member->linkStruct = linkStruct;
+        if (length >= (int)sizeof(member->linkStruct.serialPort)) length = sizeof(member->linkStruct.serialPort) - 1;
+        memcpy(member->linkStruct.serialPort, port, length);
+        member->linkStruct.serialPort[length] = '\0';
+        member->fd = fd;
+        member->nextOffset = &nextOffset;
+        member->fileSize = fileSize;
+        member->filename = filename;
+        member->failed = 1;
+
+        if (pthread_create(&threads[numMembers], NULL, linkStruct.role == LlTx ? txStripeMember : rxStripeMember, member) != 0) {
+            printf("%s: Unable to start the member link of %s.\n", __func__, member->linkStruct.serialPort);
+            break;
+        }
+        numMembers++;
+
+        port += strcspn(port, ",");
+        if (*port == ',') port++;
+    }
+
+    int failed = numMembers == 0;
+    for (int i = 0; i < numMembers; i++) {
+        pthread_join(threads[i], NULL);
+        failed |= members[i].failed;
+    }
+
+    // Every member announces the size, and all the parts must have arrived
+    if (linkStruct.role == LlRx && !failed) {
+        for (int i = 0; i < numMembers; i++) failed |= members[i].fileSize != members[0].fileSize;
+        if (nextOffset != members[0].fileSize) {
+            printf("%s: Received %ld of %ld bytes.\n", __func__, nextOffset, members[0].fileSize);
+            failed = 1;
+        }
+    }
+
+    close(fd);
+    return failed ? -1 : 0;
+}
+
+
 /**
  * Main application layer function, that calls different functions depending on role.
  * serialPort - serial port path
@@ -486,6 +848,14 @@ void applicationLayer(const char *serialPort, const char *role, int baudRate, in
         .nRetransmissions = nTries,
         .timeout = timeout
     };
+
+    // Several serial ports (e.g. /dev/ttyS10,/dev/ttyS12) stripe the file over one link each
+    if (strchr(serialPort, ',') != NULL) {
+        if (stripeApplication(linkStruct, serialPort, filename) == -1) {
+            printf("%s, Error in stripeApplication.\n", __func__);
+        }
+        return;
+    }
     strcpy(linkStruct.serialPort, serialPort);
 
     // Call function depending on role
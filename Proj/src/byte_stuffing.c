@@ -0,0 +1,278 @@
+// Byte stuffing kernels implementation
+// Clean runs (no FLAG / ESCAPE_OCTET) are found with SIMD compares and copied in bulk,
+// the BCC2 (XOR of the data) is accumulated in the same pass.
+#include "byte_stuffing.h"
+
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__SSE2__)
+#define HAVE_SSE2 1
+#include <immintrin.h>
+#endif
+
+#if defined(HAVE_SSE2) && defined(__GNUC__)
+#define HAVE_AVX2 1
+#endif
+
+
+////////////////////////////////////////////////
+// SCALAR
+////////////////////////////////////////////////
+/**
+ * Byte stuffing, one byte at a time
+ * returns number of bytes written to out
+*/
+int stuffBytesScalar(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2) {
+    unsigned char acc = 0x00;
+    int j = 0;
+    for (int i = 0; i < bufSize; i++) {
+        unsigned char byte = buf[i];
+        acc ^= byte;
+        if (byte == FLAG || byte == ESCAPE_OCTET) {
+            out[j++] = ESCAPE_OCTET;
+            out[j++] = byte ^ ESCAPE_XOR;
+        } else {
+            out[j++] = byte;
+        }
+    }
+    *bcc2 = acc;
+    return j;
+}
+
+/**
+ * Byte destuffing, one byte at a time
+ * returns number of bytes written to out
+ *        -1 if buf ends with an escape octet
+*/
+int destuffBytesScalar(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2) {
+    unsigned char acc = 0x00;
+    int j = 0;
+    for (int i = 0; i < bufSize; i++) {
+        unsigned char byte = buf[i];
+        if (byte == ESCAPE_OCTET) {
+            if (++i == bufSize) return -1;
+            byte = buf[i] ^ ESCAPE_XOR;
+        }
+        acc ^= byte;
+        out[j++] = byte;
+    }
+    *bcc2 = acc;
+    return j;
+}
+
+
+#ifdef HAVE_SSE2
+////////////////////////////////////////////////
+// SSE2 (16 bytes per step)
+////////////////////////////////////////////////
+/**
+ * XOR of the 16 bytes of a vector
+*/
+static unsigned char foldXor128(__m128i v) {
+    v = _mm_xor_si128(v, _mm_srli_si128(v, 8));
+    v = _mm_xor_si128(v, _mm_srli_si128(v, 4));
+    v = _mm_xor_si128(v, _mm_srli_si128(v, 2));
+    v = _mm_xor_si128(v, _mm_srli_si128(v, 1));
+    return (unsigned char)_mm_cvtsi128_si32(v);
+}
+
+static int stuffBytesSSE2(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2) {
+    const __m128i flag = _mm_set1_epi8((char)FLAG);
+    const __m128i escape = _mm_set1_epi8((char)ESCAPE_OCTET);
+    __m128i acc = _mm_setzero_si128();
+    int i = 0, j = 0;
+
+    for (; i + 16 <= bufSize; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(buf + i));
+        acc = _mm_xor_si128(acc, chunk);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, flag), _mm_cmpeq_epi8(chunk, escape)));
+        _mm_storeu_si128((__m128i *)(out + j), chunk);
+        if (mask == 0) { // Clean run
+            j += 16;
+            continue;
+        }
+        // Only the bytes from the first special one on have to be moved
+        int k = __builtin_ctz(mask);
+        j += k;
+        for (; k < 16; k++) {
+            unsigned char byte = buf[i + k];
+            if (mask & (1 << k)) {
+                out[j++] = ESCAPE_OCTET;
+                out[j++] = byte ^ ESCAPE_XOR;
+            } else {
+                out[j++] = byte;
+            }
+        }
+    }
+
+    unsigned char tail;
+    j += stuffBytesScalar(buf + i, bufSize - i, out + j, &tail);
+    *bcc2 = foldXor128(acc) ^ tail;
+    return j;
+}
+
+static int destuffBytesSSE2(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2) {
+    const __m128i escape = _mm_set1_epi8((char)ESCAPE_OCTET);
+    __m128i acc = _mm_setzero_si128();
+    unsigned char scalarAcc = 0x00;
+    int i = 0, j = 0;
+
+    while (i + 16 <= bufSize) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(buf + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, escape));
+        if (mask == 0) { // Clean run
+            acc = _mm_xor_si128(acc, chunk);
+            _mm_storeu_si128((__m128i *)(out + j), chunk);
+            i += 16;
+            j += 16;
+            continue;
+        }
+        // Copy up to the escape octet, then destuff it (the escaped byte may be in the next chunk)
+        int k = __builtin_ctz(mask);
+        for (int n = 0; n < k; n++) {
+            scalarAcc ^= buf[i + n];
+            out[j++] = buf[i + n];
+        }
+        i += k + 1;
+        if (i == bufSize) return -1;
+        unsigned char byte = buf[i++] ^ ESCAPE_XOR;
+        scalarAcc ^= byte;
+        out[j++] = byte;
+    }
+
+    unsigned char tail;
+    int n = destuffBytesScalar(buf + i, bufSize - i, out + j, &tail);
+    if (n == -1) return -1;
+    *bcc2 = foldXor128(acc) ^ scalarAcc ^ tail;
+    return j + n;
+}
+#endif // HAVE_SSE2
+
+
+#ifdef HAVE_AVX2
+////////////////////////////////////////////////
+// AVX2 (32 bytes per step)
+////////////////////////////////////////////////
+__attribute__((target("avx2")))
+static unsigned char foldXor256(__m256i v) {
+    __m128i half = _mm_xor_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return foldXor128(half);
+}
+
+__attribute__((target("avx2")))
+static int stuffBytesAVX2(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2) {
+    const __m256i flag = _mm256_set1_epi8((char)FLAG);
+    const __m256i escape = _mm256_set1_epi8((char)ESCAPE_OCTET);
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0, j = 0;
+
+    for (; i + 32 <= bufSize; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(buf + i));
+        acc = _mm256_xor_si256(acc, chunk);
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, flag), _mm256_cmpeq_epi8(chunk, escape)));
+        _mm256_storeu_si256((__m256i *)(out + j), chunk);
+        if (mask == 0) { // Clean run
+            j += 32;
+            continue;
+        }
+        int k = __builtin_ctz(mask);
+        j += k;
+        for (; k < 32; k++) {
+            unsigned char byte = buf[i + k];
+            if (mask & (1u << k)) {
+                out[j++] = ESCAPE_OCTET;
+                out[j++] = byte ^ ESCAPE_XOR;
+            } else {
+                out[j++] = byte;
+            }
+        }
+    }
+
+    unsigned char tail;
+    j += stuffBytesSSE2(buf + i, bufSize - i, out + j, &tail);
+    *bcc2 = foldXor256(acc) ^ tail;
+    return j;
+}
+
+__attribute__((target("avx2")))
+static int destuffBytesAVX2(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2) {
+    const __m256i escape = _mm256_set1_epi8((char)ESCAPE_OCTET);
+    __m256i acc = _mm256_setzero_si256();
+    unsigned char scalarAcc = 0x00;
+    int i = 0, j = 0;
+
+    while (i + 32 <= bufSize) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(buf + i));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, escape));
+        if (mask == 0) { // Clean run
+            acc = _mm256_xor_si256(acc, chunk);
+            _mm256_storeu_si256((__m256i *)(out + j), chunk);
+            i += 32;
+            j += 32;
+            continue;
+        }
+        int k = __builtin_ctz(mask);
+        for (int n = 0; n < k; n++) {
+            scalarAcc ^= buf[i + n];
+            out[j++] = buf[i + n];
+        }
+        i += k + 1;
+        if (i == bufSize) return -1;
+        unsigned char byte = buf[i++] ^ ESCAPE_XOR;
+        scalarAcc ^= byte;
+        out[j++] = byte;
+    }
+
+    unsigned char tail;
+    int n = destuffBytesSSE2(buf + i, bufSize - i, out + j, &tail);
+    if (n == -1) return -1;
+    *bcc2 = foldXor256(acc) ^ scalarAcc ^ tail;
+    return j + n;
+}
+#endif // HAVE_AVX2
+
+
+////////////////////////////////////////////////
+// DISPATCH
+////////////////////////////////////////////////
+typedef int (*kernel_t)(const unsigned char *, int, unsigned char *, unsigned char *);
+
+static kernel_t stuffKernel = NULL;
+static kernel_t destuffKernel = NULL;
+static const char *kernelName = "scalar";
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Picks the widest kernels the CPU supports (only done once)
+*/
+static void selectKernels() {
+    stuffKernel = stuffBytesScalar;
+    destuffKernel = destuffBytesScalar;
+#ifdef HAVE_SSE2
+    stuffKernel = stuffBytesSSE2;
+    destuffKernel = destuffBytesSSE2;
+    kernelName = "sse2";
+#endif
+#ifdef HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        stuffKernel = stuffBytesAVX2;
+        destuffKernel = destuffBytesAVX2;
+        kernelName = "avx2";
+    }
+#endif
+}
+
+int stuffBytes(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2) {
+    pthread_once(&kernelsOnce, selectKernels);
+    return stuffKernel(buf, bufSize, out, bcc2);
+}
+
+int destuffBytes(const unsigned char *buf, int bufSize, unsigned char *out, unsigned char *bcc2) {
+    pthread_once(&kernelsOnce, selectKernels);
+    return destuffKernel(buf, bufSize, out, bcc2);
+}
+
+const char *byteStuffingKernel() {
+    pthread_once(&kernelsOnce, selectKernels);
+    return kernelName;
+}
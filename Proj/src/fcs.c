@@ -0,0 +1,173 @@
+// Frame check sequence implementation
+// Both CRCs are reflected, so they share the same slicing-by-8 scheme: table k holds the CRC
+// of a byte followed by k zero bytes, which lets 8 input bytes be folded with 8 lookups.
+#include "fcs.h"
+
+#include <pthread.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAVE_SSE42 1
+#include <immintrin.h>
+#endif
+
+#define CRC16_POLY 0x8408     // 0x1021 reflected
+#define CRC32C_POLY 0x82F63B78 // 0x1EDC6F41 reflected
+
+static unsigned short crc16Table[8][256];
+static unsigned int crc32cTable[8][256];
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Fills the slicing-by-8 tables (only done once)
+*/
+static void initTables() {
+    for (int i = 0; i < 256; i++) {
+        unsigned short value16 = i;
+        unsigned int value32 = i;
+        for (int bit = 0; bit < 8; bit++) {
+            value16 = (value16 & 1) ? (value16 >> 1) ^ CRC16_POLY : value16 >> 1;
+            value32 = (value32 & 1) ? (value32 >> 1) ^ CRC32C_POLY : value32 >> 1;
+        }
+        crc16Table[0][i] = value16;
+        crc32cTable[0][i] = value32;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int i = 0; i < 256; i++) {
+            crc16Table[k][i] = (crc16Table[k - 1][i] >> 8) ^ crc16Table[0][crc16Table[k - 1][i] & 0xFF];
+            crc32cTable[k][i] = (crc32cTable[k - 1][i] >> 8) ^ crc32cTable[0][crc32cTable[k - 1][i] & 0xFF];
+        }
+    }
+}
+
+
+////////////////////////////////////////////////
+// SLICING-BY-8
+////////////////////////////////////////////////
+unsigned short crc16Update(unsigned short crc, const unsigned char *buf, int bufSize) {
+    pthread_once(&tablesOnce, initTables);
+
+    crc ^= 0xFFFF;
+    int i = 0;
+    for (; i + 8 <= bufSize; i += 8) {
+        const unsigned char *p = buf + i;
+        unsigned short x = crc ^ (p[0] | (p[1] << 8));
+        crc = crc16Table[7][x & 0xFF] ^ crc16Table[6][x >> 8] ^
+              crc16Table[5][p[2]] ^ crc16Table[4][p[3]] ^ crc16Table[3][p[4]] ^
+              crc16Table[2][p[5]] ^ crc16Table[1][p[6]] ^ crc16Table[0][p[7]];
+    }
+    for (; i < bufSize; i++) crc = (crc >> 8) ^ crc16Table[0][(crc ^ buf[i]) & 0xFF];
+    return crc ^ 0xFFFF;
+}
+
+unsigned short crc16(const unsigned char *buf, int bufSize) {
+    return crc16Update(0, buf, bufSize);
+}
+
+static unsigned int crc32cSlicingBy8Update(unsigned int crc, const unsigned char *buf, int bufSize) {
+    pthread_once(&tablesOnce, initTables);
+
+    crc ^= 0xFFFFFFFF;
+    int i = 0;
+    for (; i + 8 <= bufSize; i += 8) {
+        const unsigned char *p = buf + i;
+        unsigned int lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24));
+        crc = crc32cTable[7][lo & 0xFF] ^ crc32cTable[6][(lo >> 8) & 0xFF] ^
+              crc32cTable[5][(lo >> 16) & 0xFF] ^ crc32cTable[4][lo >> 24] ^
+              crc32cTable[3][p[4]] ^ crc32cTable[2][p[5]] ^ crc32cTable[1][p[6]] ^ crc32cTable[0][p[7]];
+    }
+    for (; i < bufSize; i++) crc = (crc >> 8) ^ crc32cTable[0][(crc ^ buf[i]) & 0xFF];
+    return crc ^ 0xFFFFFFFF;
+}
+
+unsigned int crc32cSlicingBy8(const unsigned char *buf, int bufSize) {
+    return crc32cSlicingBy8Update(0, buf, bufSize);
+}
+
+
+#ifdef HAVE_SSE42
+////////////////////////////////////////////////
+// SSE4.2 (CRC32 instruction, 8 bytes per step)
+////////////////////////////////////////////////
+__attribute__((target("sse4.2")))
+static unsigned int crc32cSSE42(unsigned int previous, const unsigned char *buf, int bufSize) {
+    unsigned long long crc = previous ^ 0xFFFFFFFF;
+    int i = 0;
+    for (; i + 8 <= bufSize; i += 8) {
+        unsigned long long word;
+        __builtin_memcpy(&word, buf + i, 8);
+        crc = _mm_crc32_u64(crc, word);
+    }
+    unsigned int crc32 = (unsigned int)crc;
+    for (; i < bufSize; i++) crc32 = _mm_crc32_u8(crc32, buf[i]);
+    return crc32 ^ 0xFFFFFFFF;
+}
+#endif // HAVE_SSE42
+
+
+////////////////////////////////////////////////
+// DISPATCH
+////////////////////////////////////////////////
+static unsigned int (*crc32cKernel)(unsigned int, const unsigned char *, int) = NULL;
+static const char *kernelName = "slicing-by-8";
+static pthread_once_t kernelOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Picks the CRC-32C kernel the CPU supports (only done once)
+*/
+static void selectKernel() {
+    crc32cKernel = crc32cSlicingBy8Update;
+#ifdef HAVE_SSE42
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc32cKernel = crc32cSSE42;
+        kernelName = "sse4.2";
+    }
+#endif
+}
+
+unsigned int crc32cUpdate(unsigned int crc, const unsigned char *buf, int bufSize) {
+    pthread_once(&kernelOnce, selectKernel);
+    return crc32cKernel(crc, buf, bufSize);
+}
+
+unsigned int crc32c(const unsigned char *buf, int bufSize) {
+    return crc32cUpdate(0, buf, bufSize);
+}
+
+const char *crcKernel() {
+    pthread_once(&kernelOnce, selectKernel);
+    return kernelName;
+}
+
+int fcsSize(FcsType type) {
+    switch (type) {
+        case FCS_CRC16: return 2;
+        case FCS_CRC32C: return 4;
+        case FCS_NONE: return 0;
+        default: return 1;
+    }
+}
+
+void computeFcsv(FcsType type, const struct iovec *iov, int iovcnt, unsigned char *fcs) {
+    if (type == FCS_CRC16) {
+        unsigned short crc = 0;
+        for (int v = 0; v < iovcnt; v++) crc = crc16Update(crc, iov[v].iov_base, iov[v].iov_len);
+        fcs[0] = crc & 0xFF;
+        fcs[1] = crc >> 8;
+    } else if (type == FCS_CRC32C) {
+        unsigned int crc = 0;
+        for (int v = 0; v < iovcnt; v++) crc = crc32cUpdate(crc, iov[v].iov_base, iov[v].iov_len);
+        for (int i = 0; i < 4; i++) fcs[i] = (crc >> (8 * i)) & 0xFF;
+    } else if (type == FCS_BCC2) {
+        unsigned char bcc2 = 0x00;
+        for (int v = 0; v < iovcnt; v++) {
+            const unsigned char *buf = iov[v].iov_base;
+            for (size_t i = 0; i < iov[v].iov_len; i++) bcc2 ^= buf[i];
+        }
+        fcs[0] = bcc2;
+    }
+}
+
+void computeFcs(FcsType type, const unsigned char *buf, int bufSize, unsigned char *fcs) {
+    struct iovec iov = {(void *)buf, bufSize};
+    computeFcsv(type, &iov, 1, fcs);
+}
@@ -0,0 +1,203 @@
+// Forward error correction implementation
+// Systematic Reed-Solomon code over GF(256) (polynomial 0x11D), generator roots a^0 .. a^(n-1).
+// Decoding: syndromes, Berlekamp-Massey (error locator), Chien search (positions), Forney (values).
+// Codewords are polynomials with the first byte as the highest degree coefficient.
+#include "fec.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define GF_POLY 0x11D
+#define BLOCK_SIZE 255
+
+static unsigned char gfExp[2 * BLOCK_SIZE];
+static unsigned char gfLog[256];
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+// Generator polynomial of every parity size (highest degree first, monic), built with the tables
+// so encoders of different connections never rebuild a shared one
+static unsigned char generators[FEC_MAX_PARITY + 1][FEC_MAX_PARITY + 1];
+
+static void buildGenerators();
+
+/**
+ * Fills the exponent and logarithm tables and the generators (only done once)
+*/
+static void initTables() {
+    int x = 1;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        gfExp[i] = x;
+        gfExp[i + BLOCK_SIZE] = x;
+        gfLog[x] = i;
+        x <<= 1;
+        if (x & 0x100) x ^= GF_POLY;
+    }
+    buildGenerators();
+}
+
+static unsigned char gfMul(unsigned char a, unsigned char b) {
+    if (a == 0 || b == 0) return 0;
+    return gfExp[gfLog[a] + gfLog[b]];
+}
+
+static unsigned char gfDiv(unsigned char a, unsigned char b) {
+    if (a == 0) return 0;
+    return gfExp[gfLog[a] + BLOCK_SIZE - gfLog[b]];
+}
+
+/**
+ * Builds the generator polynomials (x - a^0)(x - a^1)...(x - a^(paritySize-1)), each one from the previous
+*/
+static void buildGenerators() {
+    memset(generators, 0, sizeof(generators));
+    generators[0][0] = 1;
+    for (int i = 0; i < FEC_MAX_PARITY; i++) { // Multiply by (x + a^i)
+        unsigned char *generator = generators[i + 1];
+        memcpy(generator, generators[i], i + 1);
+        for (int j = i + 1; j > 0; j--) generator[j] ^= gfMul(generator[j - 1], gfExp[i]);
+    }
+}
+
+static int validParity(int paritySize) {
+    return paritySize > 0 && paritySize <= FEC_MAX_PARITY;
+}
+
+int fecEncodedSize(int dataSize, int paritySize) {
+    if (!validParity(paritySize)) return dataSize;
+    int blockData = BLOCK_SIZE - paritySize;
+    int numBlocks = (dataSize + blockData - 1) / blockData;
+    return dataSize + numBlocks * paritySize;
+}
+
+/**
+ * Parity of one block (remainder of data * x^paritySize divided by the generator)
+*/
+static void encodeBlock(const unsigned char *data, int dataSize, int paritySize, unsigned char *parity) {
+    memset(parity, 0, paritySize);
+    for (int i = 0; i < dataSize; i++) {
+        unsigned char coef = data[i] ^ parity[0];
+        memmove(parity, parity + 1, paritySize - 1);
+        parity[paritySize - 1] = 0;
+        if (coef == 0) continue;
+        for (int j = 0; j < paritySize; j++) parity[j] ^= gfMul(generators[paritySize][j + 1], coef);
+    }
+}
+
+int fecEncode(const unsigned char *data, int dataSize, int paritySize, unsigned char *parity) {
+    if (!validParity(paritySize)) return -1;
+    pthread_once(&tablesOnce, initTables);
+
+    int blockData = BLOCK_SIZE - paritySize;
+    int written = 0;
+    for (int start = 0; start < dataSize; start += blockData) {
+        int size = dataSize - start < blockData ? dataSize - start : blockData;
+        encodeBlock(data + start, size, paritySize, parity + written);
+        written += paritySize;
+    }
+    return written;
+}
+
+/**
+ * Corrects one codeword (data followed by its parity) in place
+ * returns number of bytes corrected
+ *        -1 if there are too many errors
+*/
+static int decodeBlock(unsigned char *codeword, int size, int paritySize) {
+    unsigned char syndromes[FEC_MAX_PARITY];
+    int errors = 0;
+    for (int i = 0; i < paritySize; i++) { // S_i = codeword(a^i)
+        unsigned char s = 0;
+        for (int j = 0; j < size; j++) s = gfMul(s, gfExp[i]) ^ codeword[j];
+        syndromes[i] = s;
+        errors |= s;
+    }
+    if (errors == 0) return 0;
+
+    // Berlekamp-Massey (lowest degree first)
+    unsigned char locator[FEC_MAX_PARITY + 1] = {1}, previous[FEC_MAX_PARITY + 1] = {1}, temp[FEC_MAX_PARITY + 1];
+    int degree = 0, shift = 1;
+    unsigned char lastDiscrepancy = 1;
+    for (int n = 0; n < paritySize; n++) {
+        unsigned char discrepancy = syndromes[n];
+        for (int i = 1; i <= degree; i++) discrepancy ^= gfMul(locator[i], syndromes[n - i]);
+
+        if (discrepancy == 0) {
+            shift++;
+            continue;
+        }
+        unsigned char coef = gfDiv(discrepancy, lastDiscrepancy);
+        if (2 * degree <= n) {
+            memcpy(temp, locator, sizeof(locator));
+            for (int i = 0; i + shift <= paritySize; i++) locator[i + shift] ^= gfMul(coef, previous[i]);
+            degree = n + 1 - degree;
+            memcpy(previous, temp, sizeof(previous));
+            lastDiscrepancy = discrepancy;
+            shift = 1;
+        } else {
+            for (int i = 0; i + shift <= paritySize; i++) locator[i + shift] ^= gfMul(coef, previous[i]);
+            shift++;
+        }
+    }
+    if (2 * degree > paritySize) return -1;
+
+    // Error evaluator: syndromes(x) * locator(x) mod x^paritySize
+    unsigned char evaluator[FEC_MAX_PARITY] = {0};
+    for (int i = 0; i < paritySize; i++) {
+        for (int j = 0; j <= degree && j <= i; j++) evaluator[i] ^= gfMul(syndromes[i - j], locator[j]);
+    }
+
+    // Chien search over the positions of this codeword, Forney for the values
+    int found = 0;
+    for (int power = 0; power < size; power++) {
+        unsigned char inverse = gfExp[(BLOCK_SIZE - power) % BLOCK_SIZE]; // X^-1 for X = a^power
+        unsigned char value = 0, x = 1;
+        for (int i = 0; i <= degree; i++) {
+            value ^= gfMul(locator[i], x);
+            x = gfMul(x, inverse);
+        }
+        if (value != 0) continue;
+
+        unsigned char numerator = 0, derivative = 0;
+        x = 1;
+        for (int i = 0; i < paritySize; i++) {
+            numerator ^= gfMul(evaluator[i], x);
+            if (i + 1 <= degree && (i & 1) == 0) derivative ^= gfMul(locator[i + 1], x); // Odd terms only
+            x = gfMul(x, inverse);
+        }
+        if (derivative == 0) return -1;
+
+        codeword[size - 1 - power] ^= gfMul(gfExp[power], gfDiv(numerator, derivative));
+        found++;
+    }
+    return found == degree ? found : -1;
+}
+
+int fecDecode(unsigned char *encoded, int encodedSize, int paritySize, int *corrected) {
+    *corrected = 0;
+    if (!validParity(paritySize)) return encodedSize;
+    pthread_once(&tablesOnce, initTables);
+
+    // Every block but the last one is full, so the number of blocks follows from the size
+    int numBlocks = (encodedSize + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int dataSize = encodedSize - numBlocks * paritySize;
+    int blockData = BLOCK_SIZE - paritySize;
+    if (dataSize < 0 || fecEncodedSize(dataSize, paritySize) != encodedSize) return -1;
+
+    unsigned char codeword[BLOCK_SIZE];
+    for (int block = 0; block < numBlocks; block++) {
+        int start = block * blockData;
+        int size = dataSize - start < blockData ? dataSize - start : blockData;
+        unsigned char *parity = encoded + dataSize + block * paritySize;
+
+        memcpy(codeword, encoded + start, size);
+        memcpy(codeword + size, parity, paritySize);
+        int fixed = decodeBlock(codeword, size + paritySize, paritySize);
+        if (fixed == -1) return -1;
+        if (fixed > 0) {
+            memcpy(encoded + start, codeword, size);
+            memcpy(parity, codeword + size, paritySize);
+            *corrected += fixed;
+        }
+    }
+    return dataSize;
+}
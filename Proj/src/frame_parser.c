@@ -0,0 +1,242 @@
+// Frame parser implementation
+// One state machine for every frame type: SU frames are F A C BCC1 F, I frames have a data
+// field between BCC1 and the closing flag. Each byte is classified and the next state and the
+// action to run come from a precomputed table.
+#include "frame_parser.h"
+#include "byte_stuffing.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parser states
+typedef enum {START, FLAG_RCV, A_RCV, C_RCV, BCC_OK, DATA_RCV, NUM_STATES} parser_state_t;
+
+// Byte classes
+typedef enum {CLASS_OTHER, CLASS_FLAG, CLASS_ADDRESS, CLASS_EXPECTED, NUM_CLASSES} byte_class_t;
+
+// Actions run on a transition
+typedef enum {ACTION_NONE, ACTION_ADDRESS, ACTION_CONTROL, ACTION_FIRST_DATA, ACTION_DATA, ACTION_EMIT_SU, ACTION_EMIT_I, ACTION_BAD_BCC1} action_t;
+
+typedef struct {
+    unsigned char next;
+    unsigned char action;
+} transition_t;
+
+static const transition_t transitions[NUM_STATES][NUM_CLASSES] = {
+    //             CLASS_OTHER                     CLASS_FLAG                      CLASS_ADDRESS                   CLASS_EXPECTED
+    [START]    = {{START, ACTION_NONE},           {FLAG_RCV, ACTION_NONE},        {START, ACTION_NONE},           {START, ACTION_NONE}},
+    [FLAG_RCV] = {{START, ACTION_NONE},           {FLAG_RCV, ACTION_NONE},        {A_RCV, ACTION_ADDRESS},        {START, ACTION_NONE}},
+    [A_RCV]    = {{C_RCV, ACTION_CONTROL},        {FLAG_RCV, ACTION_NONE},        {C_RCV, ACTION_CONTROL},        {C_RCV, ACTION_CONTROL}},
+    [C_RCV]    = {{START, ACTION_BAD_BCC1},       {FLAG_RCV, ACTION_NONE},        {START, ACTION_BAD_BCC1},       {BCC_OK, ACTION_NONE}},
+    [BCC_OK]   = {{DATA_RCV, ACTION_FIRST_DATA},  {FLAG_RCV, ACTION_EMIT_SU},     {DATA_RCV, ACTION_FIRST_DATA},  {DATA_RCV, ACTION_FIRST_DATA}},
+    [DATA_RCV] = {{DATA_RCV, ACTION_DATA},        {FLAG_RCV, ACTION_EMIT_I},      {DATA_RCV, ACTION_DATA},        {DATA_RCV, ACTION_DATA}},
+};
+
+static unsigned char byteClass[256];
+static pthread_once_t byteClassOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Fills the byte class table (only done once)
+*/
+static void initByteClasses() {
+    memset(byteClass, CLASS_OTHER, sizeof(byteClass));
+    byteClass[FLAG] = CLASS_FLAG;
+    byteClass[ADDRESS_SENT_BY_TX] = CLASS_ADDRESS;
+    byteClass[ADDRESS_SENT_BY_RX] = CLASS_ADDRESS;
+}
+
+int initFrameParser(FrameParser *parser, int maxDataSize) {
+    pthread_once(&byteClassOnce, initByteClasses);
+
+    parser->data = (unsigned char *)malloc(maxDataSize * sizeof(unsigned char));
+    if (parser->data == NULL) return -1;
+    parser->dataCapacity = maxDataSize;
+    setFrameParserOutput(parser, NULL, 0);
+    setFrameParserFcs(parser, FCS_BCC2);
+    parser->out = parser->data;
+    parser->outCapacity = parser->dataCapacity;
+    resetFrameParser(parser);
+    return 0;
+}
+
+void freeFrameParser(FrameParser *parser) {
+    free(parser->data);
+    parser->data = NULL;
+}
+
+void resetFrameParser(FrameParser *parser) {
+    parser->state = START;
+    parser->expected = -1;
+    parser->outSize = 0;
+    parser->escape = 0;
+    parser->bcc = 0x00;
+    parser->spilled = 0;
+    parser->overflow = 0;
+}
+
+void setFrameParserOutput(FrameParser *parser, unsigned char *out, int capacity) {
+    parser->target = out == NULL ? parser->data : out;
+    parser->targetCapacity = out == NULL ? parser->dataCapacity : capacity;
+}
+
+void setFrameParserFcs(FrameParser *parser, FcsType type) {
+    parser->fcsType = type;
+    parser->fcsSize = fcsSize(type);
+}
+
+/**
+ * Starts the data field of a new I frame (in the output set for this frame)
+*/
+static void startDataField(FrameParser *parser) {
+    parser->out = parser->target;
+    parser->outCapacity = parser->targetCapacity;
+    parser->outSize = 0;
+    parser->escape = 0;
+    parser->bcc = 0x00;
+    parser->spilled = 0;
+    parser->overflow = 0;
+}
+
+/**
+ * Destuffs one byte of the data field into the output
+ * The FCS can only be told apart from the data when the closing flag arrives, so the FCS
+ * bytes past the capacity are kept aside (spill) for a data field that fills the whole output.
+*/
+static void destuffByte(FrameParser *parser, unsigned char byte) {
+    if (parser->escape) {
+        byte ^= ESCAPE_XOR;
+        parser->escape = 0;
+    } else if (byte == ESCAPE_OCTET) {
+        parser->escape = 1;
+        return;
+    }
+
+    parser->bcc ^= byte;
+    if (parser->outSize < parser->outCapacity) parser->out[parser->outSize++] = byte;
+    else if (parser->spilled < parser->fcsSize) parser->spill[parser->spilled++] = byte;
+    else parser->overflow = 1;
+}
+
+/**
+ * Destuffs a run of data field bytes (no flags) into the output
+ * Whole runs go through the byte stuffing kernels while they are sure to fit in the output.
+*/
+static void destuffRun(FrameParser *parser, const unsigned char *bytes, int numBytes) {
+    int i = 0;
+    while (i < numBytes && !parser->overflow) {
+        int room = parser->outCapacity - parser->outSize;
+        if (parser->escape || room < 2) { // Escaped byte split across runs or end of the output
+            destuffByte(parser, bytes[i++]);
+            continue;
+        }
+
+        // Destuffing never writes more bytes than it reads, so room bytes always fit
+        int length = numBytes - i < room ? numBytes - i : room;
+        unsigned char accumulator;
+        int written = destuffBytes(bytes + i, length, parser->out + parser->outSize, &accumulator);
+        if (written == -1) { // Run ends with an escape octet, it is handled on its own
+            length--;
+            written = destuffBytes(bytes + i, length, parser->out + parser->outSize, &accumulator);
+            destuffByte(parser, bytes[i + length]);
+            i++;
+        }
+        parser->bcc ^= accumulator;
+        parser->outSize += written;
+        i += length;
+    }
+}
+
+/**
+ * Checks the data field of a complete I frame and fills the event
+*/
+static void emitIFrame(FrameParser *parser, FrameEvent *event) {
+    int size = parser->outSize + parser->spilled - parser->fcsSize; // Data without the FCS
+    int valid = size >= 0 && !parser->escape;
+
+    if (valid && parser->fcsType == FCS_NONE) {
+        valid = 1;
+    } else if (valid && parser->fcsType == FCS_BCC2) {
+        valid = parser->bcc == 0x00; // XOR of the data and BCC2 is 0 when BCC2 matches
+    } else if (valid) {
+        unsigned char received[FCS_MAX_SIZE], expected[FCS_MAX_SIZE];
+        for (int i = 0; i < parser->fcsSize; i++) { // FCS is at the end of the output, then in the spill
+            int at = size + i;
+            received[i] = at < parser->outSize ? parser->out[at] : parser->spill[at - parser->outSize];
+        }
+        computeFcs(parser->fcsType, parser->out, size, expected);
+        valid = memcmp(received, expected, parser->fcsSize) == 0;
+    }
+
+    event->type = valid ? FRAME_I : FRAME_BAD_BCC2;
+    event->data = size >= 0 ? parser->out : NULL;
+    event->size = size;
+}
+
+int parseFrameBytes(FrameParser *parser, const unsigned char *bytes, int numBytes, FrameEvent *event) {
+    event->type = FRAME_NONE;
+
+    int i = 0;
+    while (i < numBytes) {
+        // Data field: destuff everything up to the next flag at once (same as ACTION_DATA for each byte)
+        if (parser->state == DATA_RCV) {
+            const unsigned char *flag = memchr(bytes + i, FLAG, numBytes - i);
+            int end = flag == NULL ? numBytes : (int)(flag - bytes);
+            destuffRun(parser, bytes + i, end - i);
+            i = end;
+
+            // Too long for the output: rejected right away, the rest of the frame is skipped
+            if (parser->overflow) {
+                parser->state = START;
+                event->type = FRAME_BAD_BCC2;
+                event->data = NULL;
+                event->address = parser->address;
+                event->control = parser->control;
+                return i;
+            }
+            if (flag == NULL) return numBytes;
+        }
+
+        unsigned char byte = bytes[i++];
+        int class = byte == parser->expected ? CLASS_EXPECTED : byteClass[byte];
+        const transition_t transition = transitions[parser->state][class];
+        parser->state = transition.next;
+
+        switch (transition.action) {
+            case ACTION_NONE:
+                break;
+            case ACTION_ADDRESS:
+                parser->address = byte;
+                break;
+            case ACTION_CONTROL:
+                parser->control = byte;
+                parser->expected = parser->address ^ byte; // BCC1
+                break;
+            case ACTION_FIRST_DATA:
+                startDataField(parser);
+                destuffByte(parser, byte);
+                break;
+            case ACTION_DATA: // Only reached when the data field is not scanned in bulk
+                destuffByte(parser, byte);
+                break;
+            case ACTION_EMIT_SU:
+                event->type = FRAME_SU;
+                break;
+            case ACTION_EMIT_I:
+                emitIFrame(parser, event);
+                break;
+            case ACTION_BAD_BCC1:
+                event->type = FRAME_BAD_BCC1;
+                break;
+        }
+
+        if (parser->state != C_RCV) parser->expected = -1;
+
+        if (event->type != FRAME_NONE) {
+            event->address = parser->address;
+            event->control = parser->control;
+            return i;
+        }
+    }
+    return numBytes;
+}
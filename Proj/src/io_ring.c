@@ -0,0 +1,254 @@
+// io_uring serial port implementation
+// Requests are told apart by their user_data: the read into the receive buffer, the write of the
+// staging buffer and, when the ring is closed, the cancellation of the read.
+// The kernel consumes the submission queue and fills the completion queue, this side only
+// moves the submission tail and the completion head (with the memory ordering io_uring asks for).
+#include "io_ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define RING_ENTRIES 4 // A read, a write and a cancellation at most
+
+#define REQUEST_READ 1
+#define REQUEST_WRITE 2
+#define REQUEST_CANCEL 3
+
+/**
+ * Queues a request on the serial port, submitted by the next io_uring_enter
+ * (a cancellation takes the user_data of the request to cancel as buf)
+*/
+static void queueRequest(IoRing *ring, int opcode, void *buf, unsigned int len, unsigned long long userData) {
+    unsigned tail = *ring->sqTail;
+    unsigned index = tail & *ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = ring->portFd;
+    sqe->addr = (unsigned long)buf;
+    sqe->len = len;
+    sqe->off = opcode == IORING_OP_ASYNC_CANCEL ? 0 : (unsigned long long)-1; // Serial ports have no file position
+    sqe->user_data = userData;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Submits the queued requests and waits for a completion
+ * timeoutMs - 0 only submits, -1 waits forever
+ * returns 0 on success (including when the wait timed out or was interrupted)
+ *        -1 on error
+*/
+static int enter(IoRing *ring, int timeoutMs) {
+    unsigned toSubmit = *ring->sqTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    if (toSubmit == 0 && timeoutMs == 0) return 0; // Nothing to do, no system call
+
+    struct __kernel_timespec ts = {timeoutMs / 1000, (timeoutMs % 1000) * 1000000LL};
+    struct io_uring_getevents_arg arg = {.sigmask = 0, .sigmask_sz = _NSIG / 8, .ts = timeoutMs > 0 ? (unsigned long)&ts : 0};
+    unsigned flags = timeoutMs != 0 ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+    long result = syscall(__NR_io_uring_enter, ring->fd, toSubmit, timeoutMs != 0, flags, timeoutMs != 0 ? &arg : NULL, sizeof(arg));
+    if (*ring->sqTail == __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE)) ring->writeQueued = 0;
+    if (result == -1) return (errno == EINTR || errno == ETIME || errno == EAGAIN || errno == EBUSY) ? 0 : -1;
+    return 0;
+}
+
+/**
+ * Writes the staged bytes that are not being written yet, unless a write is in flight
+ * (one at a time keeps them in order)
+*/
+static void startWrite(IoRing *ring) {
+    unsigned int pending = ring->writeTail - ring->writeHead;
+    if (ring->writing > 0 || ring->error != 0 || pending == 0) return;
+
+    unsigned int start = ring->writeHead % IO_RING_WRITE_SIZE;
+    if (pending > IO_RING_WRITE_SIZE - start) pending = IO_RING_WRITE_SIZE - start; // The rest after the wrap around
+    queueRequest(ring, IORING_OP_WRITE, ring->writeBuffer + start, pending, REQUEST_WRITE);
+    ring->writing = pending;
+    ring->writeQueued = 1;
+}
+
+/**
+ * Handles the completions that arrived (no system call)
+*/
+static void reap(IoRing *ring) {
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+        int res = cqe->res;
+        if (cqe->user_data == REQUEST_READ) {
+            ring->reading = 0;
+            if (res >= 0) ring->readResult = res;
+            else if (res != -EINTR && res != -EAGAIN && res != -ECANCELED) ring->error = -res;
+        } else if (cqe->user_data == REQUEST_WRITE) {
+            ring->writing = 0;
+            if (res >= 0) ring->writeHead += res; // A short write sends the rest next
+            else if (res != -EINTR && res != -EAGAIN) ring->error = -res;
+            startWrite(ring);
+        }
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * Makes the reads of the serial port wait in the kernel: non-blocking with VMIN 1 (with VMIN 0 a read
+ * completes at once with nothing, even non-blocking). The old settings are kept for releasePort.
+ * returns 0 on success
+ *        -1 on error (the port is left as it was)
+*/
+static int takePort(IoRing *ring, int portFd) {
+    ring->portFd = portFd;
+    ring->portFlags = fcntl(portFd, F_GETFL);
+    if (ring->portFlags == -1 || tcgetattr(portFd, &ring->portSettings) == -1) return -1;
+
+    struct termios settings = ring->portSettings;
+    settings.c_cc[VMIN] = 1;
+    settings.c_cc[VTIME] = 0;
+    if (tcsetattr(portFd, TCSANOW, &settings) == -1) return -1;
+    if (fcntl(portFd, F_SETFL, ring->portFlags | O_NONBLOCK) == -1) {
+        tcsetattr(portFd, TCSANOW, &ring->portSettings);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Gives the serial port its settings back
+*/
+static void releasePort(IoRing *ring) {
+    fcntl(ring->portFd, F_SETFL, ring->portFlags);
+    tcsetattr(ring->portFd, TCSANOW, &ring->portSettings);
+}
+
+int openIoRing(IoRing *ring, int portFd) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (fd == -1) return -1;
+
+    // Waiting with a timeout needs IORING_FEAT_EXT_ARG (Linux 5.11)
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        close(fd);
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ringsSize = sqSize > cqSize ? sqSize : cqSize;
+    ring->rings = mmap(NULL, ring->ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->rings == MAP_FAILED || ring->sqes == MAP_FAILED || takePort(ring, portFd) == -1) {
+        if (ring->rings != MAP_FAILED) munmap(ring->rings, ring->ringsSize);
+        if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqesSize);
+        close(fd);
+        return -1;
+    }
+
+    char *rings = (char *)ring->rings;
+    ring->sqHead = (unsigned *)(rings + params.sq_off.head);
+    ring->sqTail = (unsigned *)(rings + params.sq_off.tail);
+    ring->sqMask = (unsigned *)(rings + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)(rings + params.sq_off.array);
+    ring->cqHead = (unsigned *)(rings + params.cq_off.head);
+    ring->cqTail = (unsigned *)(rings + params.cq_off.tail);
+    ring->cqMask = (unsigned *)(rings + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+
+    ring->fd = fd;
+    ring->reading = 0;
+    ring->readResult = -1;
+    ring->writeHead = ring->writeTail = 0;
+    ring->writing = 0;
+    ring->writeQueued = 0;
+    ring->error = 0;
+    return 0;
+}
+
+int closeIoRing(IoRing *ring) {
+    // The last frames (the DISC or its answer) must leave before the serial port is closed
+    int result = 0;
+    reap(ring);
+    while (ring->error == 0 && ring->writeHead != ring->writeTail) {
+        if (enter(ring, -1) == -1) {
+            result = -1;
+            break;
+        }
+        reap(ring);
+    }
+
+    // The read must not complete into a buffer that is freed after this (given up after a second)
+    if (ring->reading) queueRequest(ring, IORING_OP_ASYNC_CANCEL, (void *)REQUEST_READ, 0, REQUEST_CANCEL);
+    for (int i = 0; ring->reading && i < 10 && enter(ring, 100) != -1; i++) reap(ring);
+
+    if (ring->error != 0) result = -1;
+    munmap(ring->sqes, ring->sqesSize);
+    munmap(ring->rings, ring->ringsSize);
+    close(ring->fd);
+    releasePort(ring);
+    return result;
+}
+
+int ioRingRead(IoRing *ring, unsigned char *buf, int maxBytes, int timeoutMs) {
+    reap(ring);
+    if (ring->readResult == -1 && !ring->reading) {
+        queueRequest(ring, IORING_OP_READ, buf, maxBytes, REQUEST_READ);
+        ring->reading = 1;
+    }
+    // Waiting submits the new read with it, a write that is waiting goes out right away
+    int wait = ring->readResult == -1 ? timeoutMs : 0;
+    if (ring->error == 0 && (wait != 0 || ring->writeQueued) && enter(ring, wait) == -1) return -1;
+    reap(ring);
+    if (ring->error != 0) {
+        errno = ring->error;
+        return -1;
+    }
+
+    int n = ring->readResult;
+    ring->readResult = -1;
+    return n == -1 ? 0 : n;
+}
+
+int ioRingSubmit(IoRing *ring) {
+    return ring->error == 0 ? enter(ring, 0) : 0;
+}
+
+int ioRingReading(const IoRing *ring) {
+    return ring->reading;
+}
+
+int ioRingWrite(IoRing *ring, const unsigned char *bytes, int numBytes) {
+    int copied = 0;
+    while (copied < numBytes) {
+        reap(ring);
+        if (ring->error != 0) {
+            errno = ring->error;
+            return -1;
+        }
+
+        unsigned int space = IO_RING_WRITE_SIZE - (ring->writeTail - ring->writeHead);
+        if (space == 0) { // Wait for the write in flight
+            if (enter(ring, -1) == -1) return -1;
+            continue;
+        }
+        unsigned int start = ring->writeTail % IO_RING_WRITE_SIZE;
+        unsigned int n = numBytes - copied;
+        if (n > space) n = space;
+        if (n > IO_RING_WRITE_SIZE - start) n = IO_RING_WRITE_SIZE - start;
+        memcpy(ring->writeBuffer + start, bytes + copied, n);
+        ring->writeTail += n;
+        copied += n;
+        startWrite(ring);
+    }
+
+    // Sent right away, the other end may be waiting for these bytes
+    if (enter(ring, 0) == -1) return -1;
+    return numBytes;
+}
@@ -1,11 +1,25 @@
 // Link layer protocol implementation
 #include "link_layer.h"
-#include "serial_port.h"
+#include "link_layer_ext.h"
+#include "serial_ports.h"
+#include "byte_stuffing.h"
+#include "frame_parser.h"
+#include "serial_buffer.h"
+#include "io_ring.h"
+#include "fcs.h"
+#include "fec.h"
+#include "rto.h"
+#include "timer.h"
+#include "payload_size.h"
+#include "negotiation.h"
 
 #include <stdio.h>
 #include <unistd.h>
-#include <signal.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/epoll.h>
 
 // MISC
 #define _POSIX_SOURCE 1 // POSIX compliant source
@@ -22,10 +36,8 @@ volatile int STOP = FALSE;
 #define I_FRAME_1 0x80
 
 // Frame Fields
-#define FLAG 0x7E
-
-#define ADDRESS_SENT_BY_TX 0x03 // or replies sent by receiver.
-#define ADDRESS_SENT_BY_RX 0x01 // or replies sent by transmitter.
+// FLAG, ESCAPE_OCTET and ESCAPE_XOR are defined in byte_stuffing.h
+// ADDRESS_SENT_BY_TX and ADDRESS_SENT_BY_RX are defined in frame_parser.h
 
 #define CONTROL_SET 0x03
 #define CONTROL_UA 0x07
@@ -36,403 +48,1817 @@ volatile int STOP = FALSE;
 #define CONTROL_REJ1 0x55
 #define CONTROL_DISC 0x0B
 
-#define ESCAPE_OCTET 0x7D
-#define ESCAPE_XOR 0x20
+// Extended control fields (modulo-8 sequence numbers, used by the sliding window modes)
+// I frames keep the high bit set, N(S) goes in bits 4-6.
+// Supervision frames carry N(R) (next frame expected by the receiver) in bits 0-2.
+// In duplex sessions I frames carry N(R) in bits 0-2 too (piggybacked acknowledgement).
+#define CONTROL_I(ns) (0x80 | ((ns) << 4))
+#define CONTROL_I_NR(control) ((control) & 0x07)
+#define CONTROL_RR(nr) (0x20 | (nr))
+#define CONTROL_REJ(nr) (0x30 | (nr))
+#define CONTROL_SREJ(nr) (0x40 | (nr))
+
+// Poll / Final: a RR with the P/F bit set is a poll when tx sends it (with the address of its I frames)
+// and the answer, sent by rx right away, otherwise. Stop-and-wait has its own two values.
+#define CONTROL_PF 0x08
+#define CONTROL_RR0_PF 0xBA
+#define CONTROL_RR1_PF 0xBB
+
+// ARQ modes
+#define ARQ_STOP_AND_WAIT 0 // Window of 1, modulo-2 (I_FRAME_0/I_FRAME_1, RR0/RR1, REJ0/REJ1)
+#define ARQ_GO_BACK_N 1     // Window of GBN_WINDOW_SIZE, modulo-8 extended control fields
+#define ARQ_SELECTIVE_REPEAT 2 // Window of SR_WINDOW_SIZE, modulo-8, SREJ and per-frame timers
+
+#ifndef ARQ_MODE
+#define ARQ_MODE ARQ_STOP_AND_WAIT
+#endif
+
+// Frame check sequence of I frames (FCS_BCC2, FCS_CRC16 or FCS_CRC32C, see fcs.h)
+#ifndef FCS_TYPE
+#define FCS_TYPE FCS_BCC2
+#endif
+
+// Forward error correction: Reed-Solomon parity bytes per block of I frame data (0 disables it, see fec.h)
+#ifndef FEC_PARITY
+#define FEC_PARITY 0
+#endif
+
+// Data + FCS once the largest FEC parity is added (a block holds at least 255 - FEC_MAX_PARITY bytes)
+#define FEC_BUFFER_SIZE (MAX_PAYLOAD_SIZE + FCS_MAX_SIZE + 8 * FEC_MAX_PARITY)
+
+// Retransmission timeout of I frames, adapted to the measured round trip time (the configured timeout is the maximum)
+#ifndef RTO_MIN_MS
+#define RTO_MIN_MS 50
+#endif
+
+// Delayed acknowledgements (sliding window modes): one RR for every ACK_EVERY frames accepted, or ACK_DELAY_MS
+// after the oldest frame not acknowledged yet, whichever comes first. Gaps and duplicates are answered right away.
+// At most half the window is left unacknowledged, so tx always has room to keep sending (1 acknowledges every frame).
+// Larger values save more RRs but cost throughput when the round trip time, not the baud rate, limits the window.
+#ifndef ACK_EVERY
+#define ACK_EVERY 2
+#endif
+#ifndef ACK_DELAY_MS
+#define ACK_DELAY_MS 20
+#endif
+
+// The delay used: under half the smallest retransmission timeout, so the RR always reaches tx before its timer
+// for the frame expires (a longer delay makes tx poll or send the window again for frames rx already has)
+#define ACK_DELAY (ACK_DELAY_MS < RTO_MIN_MS / 2 ? ACK_DELAY_MS : RTO_MIN_MS / 2)
+
+// Checkpointing: when the retransmission timer expires tx first polls rx (a 5 byte RR with P) and only sends
+// again the frames the answer shows missing, instead of the whole window. Only used if both ends support it.
+#ifndef CHECKPOINT
+#define CHECKPOINT 1
+#endif
+
+// Both ends send I frames, their acknowledgements ride in the I frames going the other way
+// (needs Go-Back-N or Selective Repeat, rx accepts it whenever tx asks for it)
+#ifndef DUPLEX
+#define DUPLEX 0
+#endif
+
+// Negotiate the ARQ mode, FCS, FEC and sizes in the SET / UA (0 uses the options above as they are,
+// so both ends must be built alike, as before negotiation existed)
+#ifndef NEGOTIATE
+#define NEGOTIATE 1
+#endif
+
+// Options accepted from the other end (bit n for ARQ mode / FCS type n)
+#ifndef ACCEPTED_ARQ_MODES
+#define ACCEPTED_ARQ_MODES 0x07
+#endif
+#ifndef ACCEPTED_FCS_TYPES
+#define ACCEPTED_FCS_TYPES ((1 << FCS_BCC2) | (1 << FCS_CRC16) | (1 << FCS_CRC32C))
+#endif
+
+// SET and UA parameters are protected by a CRC-16 whatever FCS the session uses
+#define HANDSHAKE_FCS FCS_CRC16
+#define PARAMETER_FRAME_SIZE (STUFFED_SIZE(MAX_PARAMETERS_SIZE + FCS_MAX_SIZE) + 5)
+
+// Payload size follows the measured error rate (0 keeps every frame at MAX_PAYLOAD_SIZE)
+#ifndef ADAPTIVE_PAYLOAD
+#define ADAPTIVE_PAYLOAD 1
+#endif
+
+#define MIN_PAYLOAD_SIZE 64
+#define SU_FRAME_SIZE 5
+
+#define GBN_MODULUS 8
+#define GBN_WINDOW_SIZE 7 // Must be at most GBN_MODULUS - 1
+#define SR_MODULUS 8
+#define SR_WINDOW_SIZE 4 // Must be at most SR_MODULUS / 2
+#define MAX_MODULUS 8
+
+// Serial port I/O through an io_uring (fewer system calls), off by default. With 1 a connection whose
+// ring can not be set up (old kernel, io_uring blocked by seccomp or a container) keeps read(), write() and poll()
+#ifndef IO_URING
+#define IO_URING 0
+#endif
+
+// Requests of each direction the asynchronous interface keeps queued (ll_submitWrite / ll_submitRead fail once it is full)
+#ifndef MAX_ASYNC_REQUESTS
+#define MAX_ASYNC_REQUESTS 16
+#endif
+
+// Supervision frame types (responses to I frames)
+typedef enum {RESPONSE_RR, RESPONSE_REJ, RESPONSE_SREJ} response_t;
+
+// Reorder buffer slot (for rx, Selective Repeat)
+// Frames received out of order wait in one until the missing ones arrive.
+typedef struct {
+    unsigned char data[MAX_PAYLOAD_SIZE];
+    int size;
+    int received; // Duplicate filter, set while the frame waits to be delivered
+    int srejSent; // Only one SREJ per missing frame
+} ReorderSlot;
+
+// Transmission window slot (for tx)
+// Frames stay in the window (already stuffed) until they are acknowledged.
+typedef struct {
+    unsigned char* storage;   // Room for the largest frame of the session, allocated once and reused
+    unsigned char* frame;     // storage, or the buffer of ll_writeEncoded (the caller keeps it until the frame is acknowledged)
+    int size;
+    int retries;              // Selective Repeat: timeouts of this frame
+    Timer timer;              // Selective Repeat: retransmission timer of this frame
+    double sentAt;            // When its last byte left the serial port (ms), timers and round trip times start there
+    int retransmitted;        // Retransmitted (or polled) frames are not measured (Karn's algorithm)
+} WindowSlot;
+
+// Request of the asynchronous interface, waiting for ll_poll to complete it
+typedef struct {
+    const unsigned char* data; // Write: data of the frame
+    unsigned char* packet;     // Read: buffer the data of the frame is copied into
+    int size;                  // Write: number of data bytes
+    LinkCallback callback;
+    void* arg;
+} AsyncRequest;
+
+// Requests of one direction, completed in the order they were submitted
+typedef struct {
+    AsyncRequest requests[MAX_ASYNC_REQUESTS];
+    int head;
+    int count;
+} AsyncQueue;
+
+// Everything a link needs, so one process can drive any number of them
+struct LinkConnection {
+    // Serial Port
+    SerialPort port;
+    ReadBuffer readBuffer;
+    IoRing* ioRing; // NULL: poll backend
+    int numberOfRetransmitions;
+    int timeout;
+    LinkLayerRole role;
+
+    // Reader State Machine (shared by every frame reader, keeps partial frames between calls)
+    FrameParser parser;
+
+    // Sequence number space
+    int arqMode;
+    FcsType fcsType;
+    int fecParity;
+    unsigned char fecBuffer[FEC_BUFFER_SIZE];
+    RtoEstimator rtoEstimator;
+    int adaptivePayload;
+    PayloadSizer payloadSizer;
+    double byteRate;   // Bytes per ms on the serial port (10 bits per byte)
+    double lineFreeAt; // When the last byte written leaves the serial port (ms, monotonic clock)
+    int modulus;
+    int windowSize;
+    int maxPayloadSize;
+
+    // Duplex
+    // Each end uses the address of its role for its I frames and the other address for its responses,
+    // so the responses to a frame carry the address of the frame (SET, UA and DISC keep ADDRESS_SENT_BY_TX).
+    int duplex;
+    unsigned char sendAddress;    // I frames sent and the responses to them
+    unsigned char receiveAddress; // I frames received and the responses to them
+    int discReceived;             // Rx got the DISC of tx while it drained its own window
+
+    // Checkpointing (for tx, and both ends in duplex)
+    int checkpoint;
+    int pollSent; // Waiting for the answer to a poll
+    int pollSeq;  // nextSeq when the poll was sent (the answer covers the frames before it)
+    Timer pollTimer;
+
+    // Handshake
+    int negotiate;
+    int legacyFallback; // Rx answered a plain SET, a SET with parameters may still follow (until the first I frame)
+    unsigned char uaFrame[PARAMETER_FRAME_SIZE]; // UA sent to tx (again for every SET)
+    int uaFrameSize;
+
+    // Next sequence number expected (for rx)
+    int expectedSeq;
+    int rejSent;
+
+    // Delayed acknowledgements (for rx, and both ends in duplex)
+    int ackEvery;      // Frames accepted per RR
+    int unackedFrames; // Frames accepted since the last RR, REJ or I frame sent
+    Timer ackTimer;    // Started by the oldest of them
+
+    // Reorder buffer (for rx, Selective Repeat)
+    ReorderSlot rxWindow[MAX_MODULUS];
+
+    // Delivery queue (duplex)
+    // Frames accepted while the application is busy in llwrite wait here until llread takes them.
+    ReorderSlot deliveryQueue[MAX_MODULUS];
+    int queueHead;
+    int queueCount;
+
+    // Transmission window (for tx)
+    WindowSlot txWindow[MAX_MODULUS];
+    int windowBase; // Oldest unacknowledged sequence number
+    int nextSeq;    // Sequence number of the next frame to be queued
+
+    // Stastics
+    unsigned long totalNumOfFrames;
+    unsigned long totalNumOfValidFrames;
+    unsigned long totalNumOfInvalidFrames;
+    unsigned long totalNumOfDuplicateFrames;
+    unsigned long totalNumOfOutOfSequenceFrames;
+    unsigned long totalNumOfRetransmissions;
+    unsigned long totalNumOfTimeouts;
+    unsigned long totalNumOfCorrectedFrames;
+    unsigned long totalNumOfCorrectedBytes;
+    unsigned long totalNumOfAcks;
+    unsigned long totalNumOfPolls;
+    unsigned long totalNumOfPollsWithoutLoss; // Only a response was lost, no frame was sent again
+
+    // Timers
+    TimerSet timers;
+    Timer retransmissionTimer; // SET, DISC and the window (stop-and-wait and Go-Back-N)
+    int timeoutCount;          // Consecutive timeouts of retransmissionTimer
+
+    // Asynchronous interface
+    AsyncQueue writeRequests;
+    AsyncQueue readRequests;
+    int epollFd;     // Serial port and timerfd (created by the first ll_eventFd or ll_poll)
+    int portEvents;  // Events epollFd waits for on the serial port (and the io_uring)
+    Timer wakeTimer; // Expires right away when a request is submitted, so an event loop calls ll_poll
+};
+
+// Connection of the original interface (llopen, llwrite, llread and llclose)
+static LinkConnection* defaultConnection = NULL;
 
-// Reader State Machine && Acknowledgement State Machine
-typedef enum {START, FLAG_RCV, A_RCV, C_RCV, BCC_OK, STOP_STATE, CHECK_DATA} state_t;
+/**
+ * Counts a timeout of the retransmission timer
+*/
+void countTimeout(LinkConnection* conn) {
+    stopTimer(&conn->retransmissionTimer);
+    conn->timeoutCount++;
+    conn->totalNumOfTimeouts++;
+    printf("Timeout #%d\n", conn->timeoutCount);
+}
 
-// Serial Port (File Descriptor)
-static int fd;
-static int numberOfRetransmitions = 0;
-static int timeout = 0;
-static LinkLayerRole role;
 
-// Previous C Field (for rx)
-static int prevCField = 1; 
+////////////////////////////////////////////////
+// TRANSMISSION TIME
+////////////////////////////////////////////////
+/**
+ * Milliseconds on the monotonic clock
+*/
+double nowMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+/**
+ * Writes bytes to the serial port and keeps track of when they leave it. write() returns as soon as the
+ * bytes are queued in the kernel, the UART then sends one byte every 1 / byteRate ms after the ones before.
+ * returns the number of bytes written
+ *        -1 on error
+*/
+int writeFrame(LinkConnection* conn, const unsigned char* bytes, int numBytes) {
+    int wb = conn->ioRing != NULL ? ioRingWrite(conn->ioRing, bytes, numBytes) : writePort(&conn->port, (const char*)bytes, numBytes);
+    if (wb <= 0) return wb;
+    double now = nowMs();
+    if (conn->lineFreeAt < now) conn->lineFreeAt = now;
+    conn->lineFreeAt += wb / conn->byteRate;
+    return wb;
+}
 
-// C Field to send next (for tx)
-static int CFieldToSendNext = 0;
+/**
+ * Milliseconds until a time, 0 if it already passed
+*/
+double msUntil(double time) {
+    double ms = time - nowMs();
+    return ms > 0 ? ms : 0;
+}
 
-// Stastics
-unsigned long totalNumOfFrames = 0;
-unsigned long totalNumOfValidFrames = 0;
-unsigned long totalNumOfInvalidFrames = 0;
-unsigned long totalNumOfDuplicateFrames = 0;
-unsigned long totalNumOfRetransmissions = 0;
-unsigned long totalNumOfTimeouts = 0;
+/**
+ * Milliseconds until every byte written so far left the serial port (a timer started now only runs from then)
+*/
+double untilLineFree(LinkConnection* conn) {
+    return msUntil(conn->lineFreeAt);
+}
 
 
-// Handler
-int alarmEnabled = FALSE;
-int alarmCount = 0;
+////////////////////////////////////////////////
+// CONTROL FIELDS
+////////////////////////////////////////////////
+int ackSeq(LinkConnection* conn);
 
-void alarmHandler(int signal) {
-    alarmEnabled = FALSE;
-    alarmCount++;
-    totalNumOfTimeouts++;
-    printf("Alarm #%d\n", alarmCount);
+/**
+ * Control field of the I frame with sequence number ns
+ * Stop-and-wait keeps the original 0x00 / 0x80 values, duplex frames acknowledge the frames received.
+*/
+unsigned char iFrameControl(LinkConnection* conn, int ns) {
+    if (conn->modulus == 2) return ns ? I_FRAME_1 : I_FRAME_0;
+    return conn->duplex ? CONTROL_I(ns) | ackSeq(conn) : CONTROL_I(ns);
 }
 
+/**
+ * Control field of a supervision frame (RR or REJ) carrying nr
+*/
+unsigned char responseControl(LinkConnection* conn, response_t type, int nr) {
+    if (conn->modulus == 2) {
+        if (type == RESPONSE_RR) return nr ? CONTROL_RR1 : CONTROL_RR0;
+        return nr ? CONTROL_REJ1 : CONTROL_REJ0;
+    }
+    if (type == RESPONSE_SREJ) return CONTROL_SREJ(nr);
+    return type == RESPONSE_RR ? CONTROL_RR(nr) : CONTROL_REJ(nr);
+}
 
 /**
- * Supervision frames and Unnumbered frames state machine 
- * controlField - control field to be checked (depending on the frame type)
- * ringringEnabled - Flag (because both tx and rx use this function)
+ * Decodes the control field of an I frame
+ * ns - sequence number of the frame
+ * returns TRUE if controlField is an I frame
+ *         FALSE otherwise
+*/
+int decodeIFrameControl(LinkConnection* conn, unsigned char controlField, int* ns) {
+    if (conn->modulus == 2) {
+        if (controlField != I_FRAME_0 && controlField != I_FRAME_1) return FALSE;
+        *ns = controlField == I_FRAME_1;
+        return TRUE;
+    }
+    if ((controlField & (conn->duplex ? 0x88 : 0x8F)) != 0x80) return FALSE;
+    *ns = (controlField >> 4) & 0x07;
+    return TRUE;
+}
+
+/**
+ * Decodes the control field of a supervision frame (RR, REJ or SREJ)
+ * type - type of the response
+ * nr - sequence number carried by the response
+ * returns TRUE if controlField is a RR, a REJ or a SREJ
+ *         FALSE otherwise
+*/
+int decodeResponseControl(LinkConnection* conn, unsigned char controlField, response_t* type, int* nr) {
+    if (conn->modulus == 2) {
+        switch (controlField) {
+            case CONTROL_RR0: *type = RESPONSE_RR; *nr = 0; return TRUE;
+            case CONTROL_RR1: *type = RESPONSE_RR; *nr = 1; return TRUE;
+            case CONTROL_REJ0: *type = RESPONSE_REJ; *nr = 0; return TRUE;
+            case CONTROL_REJ1: *type = RESPONSE_REJ; *nr = 1; return TRUE;
+            default: return FALSE;
+        }
+    }
+    if ((controlField & 0xF8) == CONTROL_RR(0)) *type = RESPONSE_RR;
+    else if ((controlField & 0xF8) == CONTROL_REJ(0)) *type = RESPONSE_REJ;
+    else if ((controlField & 0xF8) == CONTROL_SREJ(0)) *type = RESPONSE_SREJ;
+    else return FALSE;
+    *nr = controlField & 0x07;
+    return TRUE;
+}
+
+/**
+ * Control field of a RR with the Poll / Final bit set
+*/
+unsigned char pollFinalControl(LinkConnection* conn, int nr) {
+    if (conn->modulus == 2) return nr ? CONTROL_RR1_PF : CONTROL_RR0_PF;
+    return CONTROL_RR(nr) | CONTROL_PF;
+}
+
+/**
+ * Decodes the control field of a RR with the Poll / Final bit set
+ * nr - sequence number carried by the RR
+ * returns TRUE if controlField is a poll or its answer
+ *         FALSE otherwise
+*/
+int decodePollFinalControl(LinkConnection* conn, unsigned char controlField, int* nr) {
+    if (conn->modulus == 2) {
+        if (controlField != CONTROL_RR0_PF && controlField != CONTROL_RR1_PF) return FALSE;
+        *nr = controlField == CONTROL_RR1_PF;
+        return TRUE;
+    }
+    if ((controlField & 0xF8) != (CONTROL_RR(0) | CONTROL_PF)) return FALSE;
+    *nr = controlField & 0x07;
+    return TRUE;
+}
+
+/**
+ * Sends a 5 byte supervision frame with the given address and control field
+ * returns 0 on success
+ *        -1 on error
+*/
+int sendSUFrame(LinkConnection* conn, unsigned char address, unsigned char controlField) {
+    unsigned char BCC1 = controlField ^ address;
+    unsigned char frame[5] = {FLAG, address, controlField, BCC1, FLAG};
+    if (writeFrame(conn, frame, 5) == -1) {
+        printf("%s: An error occurred in writeFrame\n", __func__);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Sends a 5 byte supervision frame (a response to the I frames received) with the given control field
  * returns 0 on success
  *        -1 on error
 */
-int checkSUFrame(char controlField, int* ringringEnabled){
-    state_t state = START;
-    while (state != STOP_STATE && (*ringringEnabled)) {
-        unsigned char byte = 0;
-        int rb = 0;
-        if ((rb = readByte(&byte)) == -1) {
-            printf("%s: An error occurred inside readByte.\n", __func__);
+int sendSupervisionFrame(LinkConnection* conn, unsigned char controlField) {
+    return sendSUFrame(conn, conn->receiveAddress, controlField);
+}
+
+
+/**
+ * Reads bytes from the serial port (in chunks) until the parser produces a frame event
+ * event - frame event that was produced
+ * returns 1 if event holds a frame
+ *         0 if there are no more bytes available
+ *        -1 on error
+*/
+int readFrame(LinkConnection* conn, FrameEvent* event) {
+    while (TRUE) {
+        const unsigned char* bytes;
+        int available = peekBytes(&conn->readBuffer, &bytes, 0);
+        if (available == -1) {
+            printf("%s: An error occurred inside peekBytes.\n", __func__);
             return -1;
         }
-        if (rb == 0) continue;
-        unsigned char BCC1 = 0x00;
+        if (available == 0) return 0;
 
-        switch (state) {
-            case START:
-                if (byte == FLAG) state = FLAG_RCV;
-                break;
-            case FLAG_RCV:
-                state = byte == FLAG ? FLAG_RCV : (byte == ADDRESS_SENT_BY_TX ? A_RCV : START);
-                break;
-            case A_RCV:
-                state = byte == FLAG ? FLAG_RCV : (byte == controlField ? C_RCV : START);
-                break;
-            case C_RCV:
-                BCC1 = ADDRESS_SENT_BY_TX ^ controlField;
-                state = byte == FLAG ? FLAG_RCV : (byte == BCC1 ? BCC_OK : START);
-                break;
-            case BCC_OK:
-                state = byte == FLAG ? STOP_STATE : START;
-                break;
-            case STOP_STATE:
-                break;
-            default:
-                state = START;
-                break;
+        // The parser stops right after a frame, the remaining bytes stay buffered for the next call
+        consumeBytes(&conn->readBuffer, parseFrameBytes(&conn->parser, bytes, available, event));
+        if (event->type != FRAME_NONE) return 1;
+    }
+}
+
+/**
+ * Sleeps until bytes arrive or a timer expires (it may also return earlier, callers check again)
+ * returns 0 on success
+ *        -1 on error
+*/
+int waitForFrames(LinkConnection* conn) {
+    if (conn->ioRing == NULL) return waitForEvents(&conn->timers, conn->port.fd);
+
+    // The ring waits for its read and the timers in one io_uring_enter, the bytes are left in the buffer
+    const unsigned char* bytes;
+    return peekBytes(&conn->readBuffer, &bytes, msUntilNextTimer(&conn->timers)) == -1 ? -1 : 0;
+}
+
+void sendAck(LinkConnection* conn);
+void ackSent(LinkConnection* conn);
+int sendFinal(LinkConnection* conn);
+
+/**
+ * Supervision frames and Unnumbered frames reader
+ * controlField - control field to be checked (depending on the frame type)
+ * timer - gives up when it expires (NULL waits forever, rx waits for tx)
+ * returns 1 if the frame was received
+ *         0 if the timer expired
+ *        -1 on error
+*/
+int checkSUFrame(LinkConnection* conn, unsigned char controlField, Timer* timer){
+    while (TRUE) {
+        FrameEvent event;
+        int rf = readFrame(conn, &event);
+        if (rf == -1) return -1;
+        if (rf == 0) { // Sleep until more bytes arrive or the timer expires
+            if (timer != NULL && timerExpired(timer)) return 0;
+            if (waitForFrames(conn) == -1) return -1;
+            continue;
         }
+
+        if (event.type == FRAME_SU && event.address == ADDRESS_SENT_BY_TX && event.control == controlField) return 1;
+
+
+        // Waiting for DISC: the other end did not get the last RR and sent the frame again (or polls for it)
+        int nr;
+        if (event.type == FRAME_I && event.address == conn->receiveAddress) sendAck(conn);
+        if (event.type == FRAME_SU && event.address == conn->receiveAddress && decodePollFinalControl(conn, event.control, &nr)) sendFinal(conn);
     }
-    return 0;
 }
 
 
 ////////////////////////////////////////////////
 // LLOPEN
 ////////////////////////////////////////////////
+/**
+ * Reads frames until a SET or UA arrives, with or without parameters
+ * controlField - CONTROL_SET or CONTROL_UA
+ * timer - gives up when it expires (NULL waits forever, rx waits for tx)
+ * params - parameters carried by the frame
+ * hasParams - FALSE if the frame is a plain one (old peer)
+ * returns 1 if the frame was received
+ *         0 if the timer expired
+ *        -1 on error
+*/
+int readHandshakeFrame(LinkConnection* conn, unsigned char controlField, Timer* timer, LinkParameters* params, int* hasParams) {
+    int damagedParams = FALSE; // The plain frame that follows a damaged one with parameters is skipped
+    while (TRUE) {
+        FrameEvent event;
+        int rf = readFrame(conn, &event);
+        if (rf == -1) return -1;
+        if (rf == 0) { // Sleep until more bytes arrive or the timer expires
+            if (timer != NULL && timerExpired(timer)) return 0;
+            if (waitForFrames(conn) == -1) return -1;
+            continue;
+        }
+        if (event.address != ADDRESS_SENT_BY_TX || event.control != controlField) continue;
+
+        if (event.type == FRAME_SU && !damagedParams) {
+            *hasParams = FALSE;
+            return 1;
+        }
+        damagedParams = FALSE;
+        if (event.type == FRAME_I && conn->negotiate && decodeParameters(event.data, event.size, params) == 0) {
+            *hasParams = TRUE;
+            return 1;
+        }
+
+        // The other end knows the parameters, falling back to the original protocol would only lose them
+        if (event.type == FRAME_BAD_BCC2 && conn->negotiate) damagedParams = TRUE;
+    }
+}
+
+/**
+ * Builds a SET or UA carrying parameters
+ * frame - room for PARAMETER_FRAME_SIZE bytes
+ * returns size of the frame
+*/
+int buildParameterFrame(unsigned char controlField, const LinkParameters* params, unsigned char* frame) {
+    unsigned char data[MAX_PARAMETERS_SIZE + FCS_MAX_SIZE];
+    int dataSize = encodeParameters(params, data);
+    computeFcs(HANDSHAKE_FCS, data, dataSize, data + dataSize);
+    dataSize += fcsSize(HANDSHAKE_FCS);
+
+    frame[0] = FLAG;
+    frame[1] = ADDRESS_SENT_BY_TX;
+    frame[2] = controlField;
+    frame[3] = frame[1] ^ frame[2];
+    unsigned char bcc;
+    int frameSize = 4 + stuffBytes(data, dataSize, frame + 4, &bcc);
+    frame[frameSize++] = FLAG;
+    return frameSize;
+}
+
+/**
+ * Builds a plain SET or UA (5 bytes)
+ * returns size of the frame
+*/
+int buildPlainFrame(unsigned char controlField, unsigned char* frame) {
+    frame[0] = FLAG;
+    frame[1] = ADDRESS_SENT_BY_TX;
+    frame[2] = controlField;
+    frame[3] = frame[1] ^ frame[2];
+    frame[4] = FLAG;
+    return SU_FRAME_SIZE;
+}
+
+/**
+ * Largest window of an ARQ mode
+*/
+int maxWindowSize(int mode) {
+    if (mode == ARQ_GO_BACK_N) return GBN_WINDOW_SIZE;
+    if (mode == ARQ_SELECTIVE_REPEAT) return SR_WINDOW_SIZE;
+    return 1;
+}
+
+/**
+ * Parameters given by the build options (offered by tx)
+*/
+void localParameters(LinkParameters* params) {
+    params->arqMode = ARQ_MODE;
+    params->arqModes = ACCEPTED_ARQ_MODES | (1 << ARQ_MODE);
+    params->windowSize = maxWindowSize(ARQ_MODE);
+    params->maxPayload = MAX_PAYLOAD_SIZE;
+    params->fcsType = FCS_TYPE;
+    params->fcsTypes = ACCEPTED_FCS_TYPES | (1 << FCS_TYPE);
+    params->fecParity = FEC_PARITY;
+    params->duplex = DUPLEX;
+    params->checkpoint = CHECKPOINT;
+}
+
+/**
+ * Sets up the session (ARQ mode, window, FCS, FEC and payload size) for the parameters agreed in the handshake
+ * returns 0 on success
+ *        -1 on error
+*/
+int configureSession(LinkConnection* conn, const LinkParameters* session) {
+    conn->arqMode = session->arqMode;
+    if (conn->arqMode == ARQ_GO_BACK_N) conn->modulus = GBN_MODULUS;
+    else if (conn->arqMode == ARQ_SELECTIVE_REPEAT) conn->modulus = SR_MODULUS;
+    else conn->modulus = 2;
+    conn->windowSize = session->windowSize < maxWindowSize(conn->arqMode) ? session->windowSize : maxWindowSize(conn->arqMode);
+    conn->maxPayloadSize = session->maxPayload < MAX_PAYLOAD_SIZE ? session->maxPayload : MAX_PAYLOAD_SIZE;
+    conn->duplex = session->duplex && conn->arqMode != ARQ_STOP_AND_WAIT;
+    conn->checkpoint = session->checkpoint;
+    conn->ackEvery = ACK_EVERY < (conn->windowSize + 1) / 2 ? ACK_EVERY : (conn->windowSize + 1) / 2;
+    if (conn->ackEvery < 1) conn->ackEvery = 1;
+
+    conn->fcsType = session->fcsType;
+    conn->fecParity = session->fecParity;
+    if (conn->fecParity < 0 || conn->fecParity > FEC_MAX_PARITY) {
+        printf("%s: An error occurred, FEC parity must be between 0 and %d.\n", __func__, FEC_MAX_PARITY);
+        return -1;
+    }
+
+    // FEC frames are received whole (data, FCS and parity) and checked once corrected.
+    // The handshake frame was the last one parsed, so no partial frame is lost.
+    if (conn->fecParity > 0) {
+        freeFrameParser(&conn->parser);
+        if (initFrameParser(&conn->parser, fecEncodedSize(MAX_PAYLOAD_SIZE + fcsSize(conn->fcsType), conn->fecParity)) == -1) {
+            printf("%s: An error occurred inside initFrameParser.\n", __func__);
+            return -1;
+        }
+    }
+    setFrameParserFcs(&conn->parser, conn->fecParity > 0 ? FCS_NONE : conn->fcsType);
+
+    // Frames are built straight into the slot that keeps them until they are acknowledged:
+    // header (4) + stuffed data + stuffed FCS + stuffed FEC parity + flag (1)
+    if (conn->role == LlTx || conn->duplex) {
+        int frameCapacity = ll_encodedSize(conn);
+        for (int seq = 0; seq < conn->modulus; seq++) {
+            free(conn->txWindow[seq].storage);
+            conn->txWindow[seq].storage = (unsigned char*)malloc(sizeof(unsigned char) * frameCapacity);
+            conn->txWindow[seq].frame = conn->txWindow[seq].storage;
+            if (conn->txWindow[seq].storage == NULL) {
+                printf("%s: An error occurred in malloc.\n", __func__);
+                return -1;
+            }
+        }
+    }
+
+    int minPayloadSize = MIN_PAYLOAD_SIZE < conn->maxPayloadSize ? MIN_PAYLOAD_SIZE : conn->maxPayloadSize;
+    initPayloadSizer(&conn->payloadSizer, minPayloadSize, conn->maxPayloadSize, 4 + fcsSize(conn->fcsType) + 1 + SU_FRAME_SIZE);
+    return 0;
+}
+
+/**
+ * Picks the session parameters for the offer of tx, sets the session up and builds the UA that answers it (rx)
+ * returns 0 on success
+ *        -1 on error
+*/
+int answerOffer(LinkConnection* conn, const LinkParameters* offer) {
+    LinkParameters limits, session;
+    localParameters(&limits); // rx buffers and corrects whatever tx sends
+    limits.windowSize = MAX_MODULUS - 1;
+    limits.fecParity = FEC_MAX_PARITY;
+    limits.duplex = TRUE;
+    limits.checkpoint = TRUE; // Answering polls is all rx has to do
+    negotiateParameters(offer, &limits, &session);
+    conn->uaFrameSize = buildParameterFrame(CONTROL_UA, &session, conn->uaFrame);
+    return configureSession(conn, &session);
+}
+
+/**
+ * Reads the parameters of a SET that arrived after rx fell back to the original protocol
+ * The parser checked the frame with BCC2, the data field and BCC2 hold the parameters and their handshake FCS.
+ * returns 0 on success
+ *        -1 if the frame is damaged
+*/
+int decodeLateParameters(LinkConnection* conn, const FrameEvent* event, LinkParameters* params) {
+    int fieldSize = event->size + fcsSize(conn->fcsType);
+    int size = fieldSize - fcsSize(HANDSHAKE_FCS);
+    if (event->data == NULL || conn->fecParity > 0 || size < 0 || fieldSize > MAX_PARAMETERS_SIZE + FCS_MAX_SIZE) return -1;
+
+    unsigned char fcs[FCS_MAX_SIZE];
+    computeFcs(HANDSHAKE_FCS, event->data, size, fcs);
+    if (memcmp(fcs, event->data + size, fcsSize(HANDSHAKE_FCS)) != 0) return -1;
+    legacyParameters(params);
+    return decodeParameters(event->data, size, params);
+}
+
+/**
+ * Prints the parameters of the session (with the statistics)
+*/
+void printSession(LinkConnection* conn) {
+    const char* arqNames[] = {"stop-and-wait", "Go-Back-N", "Selective Repeat"};
+    const char* fcsNames[] = {"BCC2", "CRC-16", "CRC-32C", "no FCS"};
+    printf("Link: %s (window %d%s%s), %s, FEC parity %d, payload up to %d bytes%s\n",
+           arqNames[conn->arqMode], conn->windowSize, conn->duplex ? ", duplex" : "", conn->checkpoint ? ", checkpointing" : "",
+           fcsNames[conn->fcsType], conn->fecParity, conn->maxPayloadSize, conn->ioRing != NULL ? ", io_uring" : "");
+}
+
+/**
+ * Moves the serial port to an io_uring when IO_URING is set and the kernel supports it
+ * (the poll backend is kept otherwise, nothing else changes)
+*/
+void openIoEngine(LinkConnection* conn) {
+    if (!IO_URING) return;
+    conn->ioRing = (IoRing*)malloc(sizeof(IoRing));
+    if (conn->ioRing != NULL && openIoRing(conn->ioRing, conn->port.fd) == -1) {
+        printf("%s: io_uring unavailable (%s), using poll.\n", __func__, strerror(errno));
+        free(conn->ioRing);
+        conn->ioRing = NULL;
+    }
+    readThroughRing(&conn->readBuffer, conn->ioRing);
+}
+
 /**
  * Function that opens the connection between tx and rx
+ * tx offers its parameters in the SET, rx answers with the ones the session uses in the UA.
  * connectionParameters - connection parameters (about tx or rx) 
  * returns 1 on success
  *        -1 on error
 */
-int llopen(LinkLayer connectionParameters) {
-    if (signal(SIGALRM, alarmHandler) == SIG_ERR) {
-        printf("%s: An error occurred inside signal.\n", __func__);
+int openConnection(LinkConnection* conn, LinkLayer connectionParameters) {
+    if (openTimers(&conn->timers) == -1) {
+        printf("%s: An error occurred inside openTimers.\n", __func__);
         return -1;
     }
-    numberOfRetransmitions = connectionParameters.nRetransmissions;
-    timeout = connectionParameters.timeout;
-    role = connectionParameters.role;
-
-    if ((fd = openSerialPort(connectionParameters.serialPort, connectionParameters.baudRate)) < 0) {
+    conn->numberOfRetransmitions = connectionParameters.nRetransmissions;
+    conn->timeout = connectionParameters.timeout;
+    conn->role = connectionParameters.role;
+
+    conn->expectedSeq = 0;
+    conn->rejSent = FALSE;
+    conn->windowBase = 0;
+    conn->nextSeq = 0;
+    memset(conn->txWindow, 0, sizeof(conn->txWindow));
+    memset(conn->rxWindow, 0, sizeof(conn->rxWindow));
+    conn->queueHead = 0;
+    conn->queueCount = 0;
+    conn->unackedFrames = 0;
+    conn->pollSent = FALSE;
+    conn->discReceived = FALSE;
+    conn->sendAddress = conn->role == LlTx ? ADDRESS_SENT_BY_TX : ADDRESS_SENT_BY_RX;
+    conn->receiveAddress = conn->role == LlTx ? ADDRESS_SENT_BY_RX : ADDRESS_SENT_BY_TX;
+
+    initRtoEstimator(&conn->rtoEstimator, RTO_MIN_MS, conn->timeout * 1000.0);
+    conn->adaptivePayload = ADAPTIVE_PAYLOAD;
+    conn->byteRate = connectionParameters.baudRate / 10000.0;
+    conn->lineFreeAt = 0;
+    conn->negotiate = NEGOTIATE;
+    conn->legacyFallback = FALSE;
+
+    LinkParameters local, session;
+    localParameters(&local);
+    if (!conn->negotiate) session = local;
+    else legacyParameters(&session); // Until the other end shows it knows the parameters
+
+    if (initFrameParser(&conn->parser, MAX_PAYLOAD_SIZE) == -1) {
+        printf("%s: An error occurred inside initFrameParser.\n", __func__);
         return -1;
     }
+    setFrameParserFcs(&conn->parser, HANDSHAKE_FCS);
 
-    if (role == LlTx) { // Transmitter
-        while (alarmCount < numberOfRetransmitions) {
-            int bytesWritten = 0;
-            if (alarmEnabled == FALSE){
-                // Assemble SET frame
-                unsigned char BCC1 = ADDRESS_SENT_BY_TX ^ CONTROL_SET;
-                unsigned char set_array[5] = {FLAG, ADDRESS_SENT_BY_TX, CONTROL_SET, BCC1, FLAG};
+    if (openPort(&conn->port, connectionParameters.serialPort, connectionParameters.baudRate) < 0) {
+        return -1;
+    }
+    resetReadBuffer(&conn->readBuffer, conn->port.fd);
+    openIoEngine(conn);
+
+    if (conn->role == LlTx) { // Transmitter
+        // The SET with parameters goes alone first. Once it went unanswered a plain one follows it,
+        // an old rx only understands the second (a new one that got the first would use it).
+        unsigned char setFrames[PARAMETER_FRAME_SIZE + SU_FRAME_SIZE];
+        int parameterSetSize = conn->negotiate ? buildParameterFrame(CONTROL_SET, &local, setFrames) : 0;
+        int setSize = parameterSetSize + buildPlainFrame(CONTROL_SET, setFrames + parameterSetSize);
+
+        conn->timeoutCount = 0;
+        while (conn->timeoutCount < conn->numberOfRetransmitions) {
+            // Send SET frame
+            int size = conn->negotiate && conn->timeoutCount == 0 ? parameterSetSize : setSize;
+            if (writeFrame(conn, setFrames, size) == -1) {
+                printf("%s: Error in writeFrame.\n", __func__);
+                return -1;
+            }
 
-                // Send SET frame
-                bytesWritten = writeBytes(set_array, 5);
-                if (bytesWritten == -1) {
-                    printf("%s: Error in writeBytes.\n", __func__);
+            startTimer(&conn->timers, &conn->retransmissionTimer, conn->timeout * 1000.0 + untilLineFree(conn));
+            int hasParams = FALSE;
+            int csu = readHandshakeFrame(conn, CONTROL_UA, &conn->retransmissionTimer, &session, &hasParams);
+            if (csu == -1) {
+                printf("%s: An error occoures inside readHandshakeFrame.\n", __func__);
+                return -1;   
+            }
+            else if (csu == 1){
+                stopTimer(&conn->retransmissionTimer);
+                conn->timeoutCount = 0;
+                if (hasParams && !acceptSession(&local, &session)) {
+                    printf("%s: An error occurred, rx chose parameters that were not offered.\n", __func__);
                     return -1;
                 }
+                if (!hasParams && conn->negotiate) { // Old rx
+                    legacyParameters(&session);
+                    printf("%s: Rx answered with a plain UA, using the original protocol.\n", __func__);
+                }
+                return configureSession(conn, &session) == -1 ? -1 : 1;
+            } 
+            countTimeout(conn);
+            conn->totalNumOfRetransmissions++;
+        }
+    } else if (conn->role == LlRx) { // Receiver
+        while (TRUE) {
+            LinkParameters offer;
+            int hasParams = FALSE;
+            int csu = readHandshakeFrame(conn, CONTROL_SET, NULL, &offer, &hasParams);
+            if (csu == -1) {
+                printf("%s: An error occurred inside readHandshakeFrame.\n", __func__);
+                return -1;
+            }
+
+            // The first SET decides, every later one gets the same UA (tx may get either of them).
+            // A plain SET may be all that got through of the two tx sends once the first went unanswered,
+            // a SET with parameters that follows it still sets up the session (see receiveIFrame).
+            if (hasParams) {
+                if (answerOffer(conn, &offer) == -1) return -1;
+            } else {
+                conn->uaFrameSize = buildPlainFrame(CONTROL_UA, conn->uaFrame);
+                conn->legacyFallback = conn->negotiate;
+                if (conn->negotiate) printf("%s: Tx sent a plain SET, using the original protocol.\n", __func__);
+                if (configureSession(conn, &session) == -1) return -1;
+            }
+
+            int wb = writeFrame(conn, conn->uaFrame, conn->uaFrameSize);
+            if (wb == -1) {
+                printf("%s: An error occurred inside writeFrame.\n", __func__);
+                return -1;
+            } 
+            else if (wb == conn->uaFrameSize) return 1;
+            else { 
+                conn->totalNumOfRetransmissions++; 
+                continue;
+            }
+        }
+    }
+    return -1;
+}
+
+////////////////////////////////////////////////
+// LLWRITE
+////////////////////////////////////////////////
+/**
+ * Starts (or restarts) the retransmission timer shared by the window (stop-and-wait and Go-Back-N)
+ * It belongs to the oldest outstanding frame and runs from the time that frame left the serial port.
+*/
+void startRetransmissionTimer(LinkConnection* conn) {
+    startTimer(&conn->timers, &conn->retransmissionTimer, conn->rtoEstimator.rto + msUntil(conn->txWindow[conn->windowBase].sentAt));
+}
+
+/**
+ * Stops the retransmission timer shared by the window
+*/
+void stopRetransmissionTimer(LinkConnection* conn) {
+    stopTimer(&conn->retransmissionTimer);
+}
+
+/**
+ * Starts (or restarts) the retransmission timer of a frame in the window (Selective Repeat)
+ * It runs from the time the frame left the serial port.
+*/
+void startFrameTimer(LinkConnection* conn, int seq) {
+    startTimer(&conn->timers, &conn->txWindow[seq].timer, conn->rtoEstimator.rto + msUntil(conn->txWindow[seq].sentAt));
+}
+
+/**
+ * Updates the acknowledgement carried by a frame of the window before it is sent again (duplex)
+ * The header is not stuffed (N(R) never turns it into a FLAG or an ESCAPE_OCTET).
+*/
+void refreshFrameAck(LinkConnection* conn, int seq) {
+    if (!conn->duplex) return;
+    unsigned char* frame = conn->txWindow[seq].frame;
+    frame[2] = iFrameControl(conn, seq);
+    frame[3] = frame[1] ^ frame[2];
+}
+
+/**
+ * Sends a single frame of the window again (Selective Repeat)
+ * returns 0 on success
+ *        -1 on error
+*/
+int retransmitFrame(LinkConnection* conn, int seq) {
+    refreshFrameAck(conn, seq);
+    if (writeFrame(conn, conn->txWindow[seq].frame, conn->txWindow[seq].size) == -1) {
+        printf("%s: An error occurred inside writeFrame.\n", __func__);
+        return -1;
+    }
+    conn->totalNumOfFrames++;
+    conn->totalNumOfRetransmissions++;
+    conn->txWindow[seq].sentAt = conn->lineFreeAt;
+    conn->txWindow[seq].retransmitted = TRUE;
+    if (conn->duplex) ackSent(conn);
+    startFrameTimer(conn, seq);
+    return 0;
+}
+
+/**
+ * Number of frames in the window that were not acknowledged yet
+*/
+int outstandingFrames(LinkConnection* conn) {
+    return (conn->nextSeq - conn->windowBase + conn->modulus) % conn->modulus;
+}
+
+/**
+ * Marks every frame before nr as acknowledged (cumulative acknowledgement)
+ * nr - next frame expected by the receiver
+ * returns TRUE if the window moved
+ *         FALSE if nr does not acknowledge any outstanding frame
+*/
+int acknowledgeUpTo(LinkConnection* conn, int nr) {
+    int acked = (nr - conn->windowBase + conn->modulus) % conn->modulus;
+    if (acked == 0 || acked > outstandingFrames(conn)) return FALSE;
+
+    // Round trip time of the newest frame acknowledged (from the time its last byte left, so the
+    // time to clock the frame out does not count against the timeout)
+    int newest = (nr - 1 + conn->modulus) % conn->modulus;
+    if (!conn->txWindow[newest].retransmitted) {
+        double rtt = nowMs() - conn->txWindow[newest].sentAt;
+        if (rtt < 0) rtt = 0; // The port was faster than its baud rate (a virtual cable)
+        rtoSample(&conn->rtoEstimator, rtt);
+
+        // Stop-and-wait: the link is idle for the round trip time minus the time to send the response
+        if (conn->windowSize == 1) payloadIdleSample(&conn->payloadSizer, rtt * conn->byteRate - SU_FRAME_SIZE);
+    }
+
+    while (conn->windowBase != nr) {
+        payloadSample(&conn->payloadSizer, conn->txWindow[conn->windowBase].size, FALSE);
+        stopTimer(&conn->txWindow[conn->windowBase].timer);
+        conn->windowBase = (conn->windowBase + 1) % conn->modulus;
+    }
+
+    if (outstandingFrames(conn) == 0 && conn->pollSent) { // Nothing left to ask about, a late answer is only a RR
+        conn->pollSent = FALSE;
+        stopTimer(&conn->pollTimer);
+    }
+
+    if (conn->arqMode == ARQ_SELECTIVE_REPEAT) { // Every frame has its own timer, the other end is alive
+        for (int seq = conn->windowBase; seq != conn->nextSeq; seq = (seq + 1) % conn->modulus) conn->txWindow[seq].retries = 0;
+        return TRUE;
+    }
 
-                alarm(timeout); // Set alarm to be triggered after timeout
-                alarmEnabled = TRUE;                
+    conn->timeoutCount = 0;
+    if (outstandingFrames(conn) > 0) startRetransmissionTimer(conn); // Timer now belongs to the oldest outstanding frame
+    else stopRetransmissionTimer(conn);
+    return TRUE;
+}
+
+/**
+ * Sends every outstanding frame again, starting from the oldest one (Go-Back-N)
+ * returns 0 on success
+ *        -1 on error
+*/
+int retransmitWindow(LinkConnection* conn) {
+    for (int seq = conn->windowBase; seq != conn->nextSeq; seq = (seq + 1) % conn->modulus) {
+        refreshFrameAck(conn, seq);
+        if (writeFrame(conn, conn->txWindow[seq].frame, conn->txWindow[seq].size) == -1) {
+            printf("%s: An error occurred inside writeFrame.\n", __func__);
+            return -1;
+        }
+        conn->totalNumOfFrames++;
+        conn->totalNumOfRetransmissions++;
+        conn->txWindow[seq].sentAt = conn->lineFreeAt;
+        conn->txWindow[seq].retransmitted = TRUE;
+    }
+    if (conn->duplex) ackSent(conn);
+    startRetransmissionTimer(conn);
+    return 0;
+}
+
+/**
+ * Handles a RR or REJ received by tx
+ * returns 0 on success
+ *        -1 on error
+*/
+int handleIFrameResponse(LinkConnection* conn, unsigned char response) {
+    response_t type;
+    int nr;
+    if (!decodeResponseControl(conn, response, &type, &nr)) return 0;
+
+    if (type == RESPONSE_RR) {
+        conn->totalNumOfValidFrames++;
+        acknowledgeUpTo(conn, nr);
+        return 0;
+    }
+
+    // SREJ: only frame nr is missing, the frames after it are kept by the receiver
+    if (type == RESPONSE_SREJ) {
+        conn->totalNumOfInvalidFrames++;
+        if ((nr - conn->windowBase + conn->modulus) % conn->modulus >= outstandingFrames(conn)) return 0;
+        payloadSample(&conn->payloadSizer, conn->txWindow[nr].size, TRUE);
+        return retransmitFrame(conn, nr);
+    }
+
+    // REJ: frames before nr were received, everything from nr on has to be sent again.
+    // In stop-and-wait nr is ignored (older receivers send the number of the last accepted frame).
+    conn->totalNumOfInvalidFrames++;
+    if (conn->modulus > 2) acknowledgeUpTo(conn, nr);
+    conn->timeoutCount = 0;
+    if (outstandingFrames(conn) == 0) return 0;
+    payloadSample(&conn->payloadSizer, conn->txWindow[conn->windowBase].size, TRUE); // The oldest outstanding frame was damaged
+    return retransmitWindow(conn);
+}
+
+int queueIFrame(LinkConnection* conn, FrameEvent* event);
+int flushAck(LinkConnection* conn);
+void ackSent(LinkConnection* conn);
+int handleFinal(LinkConnection* conn, int nr);
+
+/**
+ * Handles the frames that already arrived, without blocking: responses to the I frames sent
+ * and, in duplex, the I frames of the other end (queued for llread)
+ * returns 0 on success
+ *        -1 on error
+*/
+int processFrames(LinkConnection* conn) {
+    FrameEvent event;
+    response_t type;
+    int nr, rf;
+
+    while ((rf = readFrame(conn, &event)) == 1) {
+        if (event.type == FRAME_SU && event.address == conn->sendAddress && decodeResponseControl(conn, event.control, &type, &nr)) {
+            if (handleIFrameResponse(conn, event.control) == -1) return -1;
+        } else if (event.type == FRAME_SU && event.address == conn->sendAddress && decodePollFinalControl(conn, event.control, &nr)) {
+            if (handleFinal(conn, nr) == -1) return -1;
+        } else if (conn->duplex && event.address == conn->receiveAddress) {
+            if (queueIFrame(conn, &event) == -1) return -1;
+        }
+    }
+    if (rf == -1) printf("%s: An error occured in readFrame.\n", __func__);
+    return rf;
+}
+
+/**
+ * Timeout of a frame of the window, it is sent again (Selective Repeat)
+ * returns 0 on success
+ *        -1 on error (or when the maximum number of retransmissions is reached)
+*/
+int frameTimeout(LinkConnection* conn, int seq) {
+    conn->totalNumOfTimeouts++;
+    rtoBackoff(&conn->rtoEstimator);
+    conn->txWindow[seq].retries++;
+    printf("Timeout of frame %d #%d\n", seq, conn->txWindow[seq].retries);
+    if (conn->txWindow[seq].retries >= conn->numberOfRetransmitions) {
+        printf("%s: Maximum number of retransmissions reached.\n", __func__);
+        return -1;
+    }
+    return retransmitFrame(conn, seq);
+}
+
+/**
+ * Timeout of the retransmission timer shared by the window, every outstanding frame is sent again
+ * returns 0 on success
+ *        -1 on error (or when the maximum number of retransmissions is reached)
+*/
+int windowTimeout(LinkConnection* conn) {
+    countTimeout(conn);
+    if (conn->timeoutCount >= conn->numberOfRetransmitions) {
+        printf("%s: Maximum number of retransmissions reached.\n", __func__);
+        return -1;
+    }
+    rtoBackoff(&conn->rtoEstimator);
+    // With a window, frames wait behind each other in the serial port and most timeouts are that
+    // delay, the damaged frames are reported by REJ. Without one a timeout means a frame or its RR was lost.
+    if (conn->windowSize == 1) payloadSample(&conn->payloadSizer, conn->txWindow[conn->windowBase].size, TRUE);
+    return retransmitWindow(conn);
+}
+
+/**
+ * Asks the other end which frames it received (RR with P), the frames wait for the answer instead of
+ * being sent again. Their timers are stopped while the poll is outstanding.
+ * returns 0 on success
+ *        -1 on error
+*/
+int sendPoll(LinkConnection* conn) {
+    // The acknowledgement of these frames comes late whatever happened, so they are not measured
+    for (int seq = conn->windowBase; seq != conn->nextSeq; seq = (seq + 1) % conn->modulus) conn->txWindow[seq].retransmitted = TRUE;
+    conn->pollSent = TRUE;
+    conn->pollSeq = conn->nextSeq;
+    conn->totalNumOfPolls++;
+    if (conn->duplex) ackSent(conn); // The poll carries N(R) too
+    if (sendSUFrame(conn, conn->sendAddress, pollFinalControl(conn, ackSeq(conn))) == -1) return -1;
+    startTimer(&conn->timers, &conn->pollTimer, conn->rtoEstimator.rto + untilLineFree(conn));
+    return 0;
+}
+
+/**
+ * Handles the answer to a poll (RR with F): the frames sent before the poll that the other end is still
+ * missing are sent again, the others wait for their acknowledgement as before
+ * nr - next frame expected by the other end
+ * returns 0 on success
+ *        -1 on error (or when the maximum number of retransmissions is reached)
+*/
+int handleFinal(LinkConnection* conn, int nr) {
+    if (!conn->pollSent) { // Late answer, the poll already timed out (or every frame was acknowledged)
+        acknowledgeUpTo(conn, nr);
+        return 0;
+    }
+    conn->pollSent = FALSE;
+    stopTimer(&conn->pollTimer);
+    acknowledgeUpTo(conn, nr);
+    conn->timeoutCount = 0; // The other end answered, only polls that go unanswered count (as a REJ)
+
+    // Frames travel in order, so every frame sent before the poll arrived (or was lost) before it
+    int lost = (conn->pollSeq - conn->windowBase + conn->modulus) % conn->modulus;
+    if (lost > outstandingFrames(conn)) lost = 0; // Acknowledged past the poll meanwhile
+    if (lost == 0) conn->totalNumOfPollsWithoutLoss++;
+    else payloadSample(&conn->payloadSizer, conn->txWindow[conn->windowBase].size, TRUE);
+
+    if (conn->arqMode == ARQ_SELECTIVE_REPEAT) { // Only windowBase is known to be missing, the others may be buffered
+        for (int seq = conn->windowBase; seq != conn->nextSeq; seq = (seq + 1) % conn->modulus) {
+            if (conn->txWindow[seq].timer.running) continue; // Not waiting for the poll
+            if (lost > 0 && seq == conn->windowBase) { // As for a SREJ
+                conn->txWindow[seq].retries = 0;
+                if (retransmitFrame(conn, seq) == -1) return -1;
+            }
+            else startFrameTimer(conn, seq);
+        }
+        return 0;
+    }
+
+    if (lost > 0) return retransmitWindow(conn);
+    if (outstandingFrames(conn) > 0 && !conn->retransmissionTimer.running) startRetransmissionTimer(conn);
+    return 0;
+}
+
+/**
+ * Handles the retransmission timers while a poll waits for its answer: the timers that expire join
+ * the poll, and when it times out the frames waiting for it are sent again
+ * returns 0 on success
+ *        -1 on error (or when the maximum number of retransmissions is reached)
+*/
+int checkPollTimer(LinkConnection* conn) {
+    if (conn->arqMode == ARQ_SELECTIVE_REPEAT) {
+        for (int seq = conn->windowBase; seq != conn->nextSeq; seq = (seq + 1) % conn->modulus) {
+            if (timerExpired(&conn->txWindow[seq].timer)) stopTimer(&conn->txWindow[seq].timer);
+        }
+    } else if (timerExpired(&conn->retransmissionTimer)) stopRetransmissionTimer(conn);
+
+    if (!timerExpired(&conn->pollTimer)) return 0;
+    conn->pollSent = FALSE; // No answer, the poll or its answer was lost too
+    stopTimer(&conn->pollTimer);
+
+    if (conn->arqMode != ARQ_SELECTIVE_REPEAT) return outstandingFrames(conn) > 0 ? windowTimeout(conn) : 0;
+    for (int seq = conn->windowBase; seq != conn->nextSeq; seq = (seq + 1) % conn->modulus) {
+        if (!conn->txWindow[seq].timer.running && frameTimeout(conn, seq) == -1) return -1;
+    }
+    return 0;
+}
+
+/**
+ * Sends the frames of the window whose retransmission timer expired again (or polls first with checkpointing)
+ * returns 0 on success
+ *        -1 on error (or when the maximum number of retransmissions is reached)
+*/
+int checkTimers(LinkConnection* conn) {
+    if (conn->pollSent) return checkPollTimer(conn);
+
+    if (conn->arqMode == ARQ_SELECTIVE_REPEAT) { // Check the timer of every outstanding frame
+        int poll = FALSE;
+        for (int seq = conn->windowBase; seq != conn->nextSeq; seq = (seq + 1) % conn->modulus) {
+            if (!timerExpired(&conn->txWindow[seq].timer)) continue;
+            if (conn->checkpoint) { // Waits for the answer to the poll
+                stopTimer(&conn->txWindow[seq].timer);
+                poll = TRUE;
             }
+            else if (frameTimeout(conn, seq) == -1) return -1;
+        }
+        if (poll) return sendPoll(conn);
+    } else if (timerExpired(&conn->retransmissionTimer)) { // Timeout, go back to the oldest outstanding frame
+        if (!conn->checkpoint) return windowTimeout(conn);
+        stopRetransmissionTimer(conn);
+        return sendPoll(conn);
+    }
+    return 0;
+}
+
+/**
+ * Processes responses and timeouts until at most maxOutstanding frames are unacknowledged
+ * maxOutstanding - windowSize - 1 waits for a free slot, 0 drains the window,
+ *                  windowSize only handles the responses that already arrived
+ * returns 0 on success
+ *        -1 on error (or when the maximum number of retransmissions is reached)
+*/
+int serviceWindow(LinkConnection* conn, int maxOutstanding) {
+    while (TRUE) {
+        if (processFrames(conn) == -1) return -1;
+        if (outstandingFrames(conn) <= maxOutstanding) return 0;
+        if (checkTimers(conn) == -1) return -1;
+
+        // Sleep until a response arrives or a timer expires (the other end may be waiting for an acknowledgement too)
+        if (flushAck(conn) == -1) return -1;
+        if (waitForFrames(conn) == -1) {
+            printf("%s: An error occurred inside waitForFrames.\n", __func__);
+            return -1;
+        }
+    }
+}
+
+/**
+ * Size of the data of a frame gathered from iovcnt buffers
+ * returns number of data bytes
+ *        -1 if a buffer is invalid or the data does not fit in a frame
+*/
+int gatheredSize(LinkConnection* conn, const struct iovec *iov, int iovcnt) {
+    if (iov == NULL || iovcnt < 0) return -1;
+    int bufSize = 0;
+    for (int v = 0; v < iovcnt; v++) {
+        if (iov[v].iov_base == NULL && iov[v].iov_len > 0) return -1;
+        bufSize += iov[v].iov_len;
+        if (bufSize > conn->maxPayloadSize) return -1;
+    }
+    return bufSize;
+}
+
+/**
+ * Encodes the part of an I frame after its header: the stuffed data, FCS and FEC parity and the closing flag
+ * None of it depends on the sequence number (the FCS covers the data only), so a frame can be encoded before
+ * it has one. The data is the concatenation of iovcnt buffers, stuffed from each one straight into body.
+ * Only reads the session parameters, so it may run on another thread than the one that sends.
+ * body - room for ll_encodedSize bytes
+ * fecBuffer - room for FEC_BUFFER_SIZE bytes (only used with FEC)
+ * returns number of bytes of body
+*/
+int encodeIFrameBody(const LinkConnection* conn, const struct iovec *iov, int iovcnt, unsigned char* body, unsigned char* fecBuffer) {
+    int bodySize = 0;
+    unsigned char fcsAccm;
+    if (conn->fecParity > 0) { // Data + FCS + parity of both, stuffed as one field (the encoder needs it in one piece)
+        int dataSize = 0;
+        for (int v = 0; v < iovcnt; v++) {
+            memcpy(fecBuffer + dataSize, iov[v].iov_base, iov[v].iov_len);
+            dataSize += iov[v].iov_len;
+        }
+        computeFcs(conn->fcsType, fecBuffer, dataSize, fecBuffer + dataSize);
+        dataSize += fcsSize(conn->fcsType);
+        int encodedSize = dataSize + fecEncode(fecBuffer, dataSize, conn->fecParity, fecBuffer + dataSize);
+        bodySize += stuffBytes(fecBuffer, encodedSize, body, &fcsAccm);
+    } else {
+        // Byte Stuffing (BCC2 is computed in the same pass)
+        unsigned char BCC2 = 0x00;
+        for (int v = 0; v < iovcnt; v++) {
+            unsigned char partBCC2;
+            bodySize += stuffBytes(iov[v].iov_base, iov[v].iov_len, body + bodySize, &partBCC2);
+            BCC2 ^= partBCC2;
+        }
+
+        // Frame check sequence (a CRC needs its own pass over the data) and its byte stuffing
+        unsigned char fcs[FCS_MAX_SIZE];
+        if (conn->fcsType == FCS_BCC2) fcs[0] = BCC2;
+        else computeFcsv(conn->fcsType, iov, iovcnt, fcs);
+        bodySize += stuffBytes(fcs, fcsSize(conn->fcsType), body + bodySize, &fcsAccm);
+    }
+
+    body[bodySize++] = FLAG;
+    return bodySize;
+}
+
+/**
+ * Gives the I frame in the next slot of the window its header and sends it (the body is already in the slot)
+ * bodySize - number of bytes after the header (encodeIFrameBody)
+ * bufSize - number of data bytes
+ * returns 0 on success
+ *        -1 on error
+*/
+int sendEncodedIFrame(LinkConnection* conn, int bodySize, int bufSize) {
+    unsigned char* frame = conn->txWindow[conn->nextSeq].frame;
+    frame[0] = FLAG; 
+    frame[1] = conn->sendAddress;
+    frame[2] = iFrameControl(conn, conn->nextSeq);
+    frame[3] = frame[1] ^ frame[2];
+    int newFrameSize = 4 + bodySize;
+
+    // Queue the frame
+    int seq = conn->nextSeq;
+    conn->txWindow[seq].size = newFrameSize;
+    conn->txWindow[seq].retries = 0;
+    conn->txWindow[seq].retransmitted = FALSE;
+    conn->nextSeq = (conn->nextSeq + 1) % conn->modulus;
+
+    if (writeFrame(conn, frame, newFrameSize) == -1) {
+        printf("%s: An error occurred inside writeFrame.\n", __func__);
+        return -1;
+    }
+    conn->txWindow[seq].sentAt = conn->lineFreeAt;
+    conn->totalNumOfFrames++;
+    if (conn->duplex) ackSent(conn);
+    recordPayloadSize(&conn->payloadSizer, bufSize);
+
+    if (conn->arqMode == ARQ_SELECTIVE_REPEAT) startFrameTimer(conn, seq);
+    else if (outstandingFrames(conn) == 1) { // Timer is not running yet
+        startRetransmissionTimer(conn);
+        conn->timeoutCount = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * Builds an I frame in the next slot of the window and sends it (the slot must be free)
+ * The data is stuffed from each buffer straight into the window slot that keeps the frame
+ * (a header and a payload are never copied together first).
+ * bufSize - number of data bytes (gatheredSize)
+ * returns 0 on success
+ *        -1 on error
+*/
+int sendIFrame(LinkConnection* conn, const struct iovec *iov, int iovcnt, int bufSize) {
+    WindowSlot* slot = &conn->txWindow[conn->nextSeq];
+    slot->frame = slot->storage;
+    int bodySize = encodeIFrameBody(conn, iov, iovcnt, slot->frame + 4, conn->fecBuffer);
+    return sendEncodedIFrame(conn, bodySize, bufSize);
+}
+
+/**
+ * Function that tx uses to write frames to the serial port 
+ * The frame is queued in the transmission window and sent right away, the function only
+ * blocks while the window is full. llclose waits for the remaining acknowledgements.
+ * iov - Buffers with the data of the frame (before byte stuffing)
+ * iovcnt - Number of buffers
+ * returns number of data bytes written (without byte stuffing) on success
+ *        -1 on error
+*/
+int ll_writev(LinkConnection* conn, const struct iovec *iov, int iovcnt) {
+    int bufSize = gatheredSize(conn, iov, iovcnt);
+    if (bufSize == -1) return -1;
+
+    // Wait for a free slot in the window
+    if (serviceWindow(conn, conn->windowSize - 1) == -1) return -1;
+    if (sendIFrame(conn, iov, iovcnt, bufSize) == -1) return -1;
+
+    // Handle the responses that already arrived
+    if (serviceWindow(conn, conn->windowSize) == -1) return -1;
+
+    // Return number of writer characters
+    return bufSize;
+}
+
+/**
+ * Writes several packets, one I frame each
+ * Every frame goes out as soon as the window has room for it, the responses that arrive in the
+ * meantime are handled while waiting for a slot, so a batch costs about as much as its frames.
+ * iov - Buffers of every packet, one packet after the other (before byte stuffing)
+ * iovcnt - Number of buffers of each packet
+ * numPackets - Number of packets
+ * returns number of packets written on success
+ *        -1 on error
+*/
+int ll_writeBatch(LinkConnection* conn, const struct iovec *iov, const int iovcnt[], int numPackets) {
+    if (iov == NULL || iovcnt == NULL || numPackets < 0) return -1;
+    for (int i = 0; i < numPackets; i++) {
+        int bufSize = gatheredSize(conn, iov, iovcnt[i]);
+        if (bufSize == -1) return -1;
+        if (serviceWindow(conn, conn->windowSize - 1) == -1) return -1;
+        if (sendIFrame(conn, iov, iovcnt[i], bufSize) == -1) return -1;
+        iov += iovcnt[i];
+    }
+
+    // Handle the responses that already arrived
+    if (serviceWindow(conn, conn->windowSize) == -1) return -1;
+    return numPackets;
+}
+
+/**
+ * Same as ll_writev, with the data in a single buffer
+ * buf - frame to write to serial port (before byte stuffing)
+ * bufSize - Size of the frame to write to serial port (before byte stuffing)
+*/
+int ll_write(LinkConnection* conn, const unsigned char *buf, int bufSize) {
+    if (bufSize < 0 || buf == NULL) return -1;
+    struct iovec iov = {(void*)buf, bufSize};
+    return ll_writev(conn, &iov, 1);
+}
+
+/**
+ * Largest frame ll_encode can produce in this session: header (4) + stuffed data, FCS and FEC parity + flag (1)
+*/
+int ll_encodedSize(LinkConnection* conn) {
+    return 4 + STUFFED_SIZE(fecEncodedSize(conn->maxPayloadSize + FCS_MAX_SIZE, conn->fecParity)) + 1;
+}
+
+/**
+ * Encodes a frame ahead of time, for ll_writeEncoded
+ * Only reads the parameters of the session, so it may run on another thread while this one sends.
+ * The 4 bytes of the header are left for ll_writeEncoded (they depend on the sequence number).
+ * iov - Buffers with the data of the frame (before byte stuffing)
+ * iovcnt - Number of buffers
+ * frame - room for ll_encodedSize bytes
+ * returns number of bytes of the encoded frame on success
+ *        -1 on error
+*/
+int ll_encode(LinkConnection* conn, const struct iovec *iov, int iovcnt, unsigned char* frame) {
+    if (frame == NULL || gatheredSize(conn, iov, iovcnt) == -1) return -1;
+    unsigned char fecBuffer[FEC_BUFFER_SIZE]; // Not the one of the connection, which the sending thread uses
+    return 4 + encodeIFrameBody(conn, iov, iovcnt, frame + 4, fecBuffer);
+}
+
+/**
+ * Same as ll_writev, with a frame that ll_encode already encoded (only its header is added)
+ * The window sends the frame from the buffer of the caller, which must keep it until the frame is
+ * acknowledged (ll_unacknowledged), nothing is copied.
+ * frame - encoded frame
+ * frameSize - number of bytes of the encoded frame
+ * dataSize - number of data bytes it carries
+ * returns dataSize on success
+ *        -1 on error
+*/
+int ll_writeEncoded(LinkConnection* conn, unsigned char *frame, int frameSize, int dataSize) {
+    if (frame == NULL || frameSize < 5 || frameSize > ll_encodedSize(conn) || dataSize < 0 || dataSize > conn->maxPayloadSize) return -1;
+
+    // Wait for a free slot in the window
+    if (serviceWindow(conn, conn->windowSize - 1) == -1) return -1;
+    conn->txWindow[conn->nextSeq].frame = frame;
+    if (sendEncodedIFrame(conn, frameSize - 4, dataSize) == -1) return -1;
+
+    // Handle the responses that already arrived
+    if (serviceWindow(conn, conn->windowSize) == -1) return -1;
+    return dataSize;
+}
+
+/**
+ * Payload size the next llwrite should use
+ * Only the ends that send I frames measure the error rate (tx, or both in duplex),
+ * rx (and a fixed payload size) always gets the session maximum.
+*/
+int ll_payloadSize(LinkConnection* conn) {
+    if (!conn->adaptivePayload || (conn->role != LlTx && !conn->duplex)) return conn->maxPayloadSize;
+    return conn->payloadSizer.size;
+}
+
+/**
+ * Number of frames sent and not acknowledged yet (they are acknowledged in the order they were sent)
+*/
+int ll_unacknowledged(LinkConnection* conn) {
+    if (conn->role != LlTx && !conn->duplex) return 0;
+    return outstandingFrames(conn);
+}
+
+////////////////////////////////////////////////
+// LLREAD
+////////////////////////////////////////////////
+/**
+ * First sequence number rx is still missing (Selective Repeat)
+ * Frames waiting in the reorder buffer count as received, so the RR acknowledges them too.
+*/
+int firstMissingSeq(LinkConnection* conn) {
+    int seq = conn->expectedSeq;
+    for (int i = 0; i < conn->windowSize && conn->rxWindow[seq].received; i++) {
+        seq = (seq + 1) % conn->modulus;
+    }
+    return seq;
+}
+
+/**
+ * Sequence number acknowledged by a RR or by the I frames sent (next frame expected)
+*/
+int ackSeq(LinkConnection* conn) {
+    return conn->arqMode == ARQ_SELECTIVE_REPEAT ? firstMissingSeq(conn) : conn->expectedSeq;
+}
+
+/**
+ * Helper function that sends an ACK to Tx.
+ * The ACK carries the sequence number of the next frame rx expects.
+ * 
+ * This way if Tx sends frame 0, Rx should tell Tx that it wants frame 1.
+ * 
+ * returns void
+ * 
+**/
+void sendAck(LinkConnection* conn) {
+    ackSent(conn);
+    conn->totalNumOfAcks++;
+    sendSupervisionFrame(conn, responseControl(conn, RESPONSE_RR, ackSeq(conn)));
+}
+
+/**
+ * Marks every frame accepted so far as acknowledged (a RR, a REJ or, in duplex, an I frame was sent)
+*/
+void ackSent(LinkConnection* conn) {
+    conn->unackedFrames = 0;
+    stopTimer(&conn->ackTimer);
+}
+
+/**
+ * Acknowledges an accepted frame: right away once ackEvery frames wait for it, later otherwise
+ * (when the delay expires, before this end blocks or, in duplex, with the next I frame sent)
+ * returns 0 on success
+ *        -1 on error
+*/
+int acknowledgeFrame(LinkConnection* conn) {
+    if (++conn->unackedFrames >= conn->ackEvery) return flushAck(conn);
+    if (conn->unackedFrames == 1) startTimer(&conn->timers, &conn->ackTimer, ACK_DELAY);
+    return 0;
+}
+
+/**
+ * Answers a poll with the state of this end (RR with F, whether frames wait for an acknowledgement or not)
+ * returns 0 on success
+ *        -1 on error
+*/
+int sendFinal(LinkConnection* conn) {
+    ackSent(conn);
+    conn->totalNumOfAcks++;
+    return sendSupervisionFrame(conn, pollFinalControl(conn, ackSeq(conn)));
+}
+
+/**
+ * Sends the acknowledgement of the frames accepted since the last one
+ * returns 0 on success
+ *        -1 on error
+*/
+int flushAck(LinkConnection* conn) {
+    if (conn->unackedFrames == 0) return 0;
+    ackSent(conn);
+    conn->totalNumOfAcks++;
+    return sendSupervisionFrame(conn, responseControl(conn, RESPONSE_RR, ackSeq(conn)));
+}
+
+/**
+ * Asks tx to send frame seq again, once per missing frame (Selective Repeat)
+ * returns 0 on success
+ *        -1 on error
+*/
+int sendSelectiveReject(LinkConnection* conn, int seq) {
+    if (conn->rxWindow[seq].received || conn->rxWindow[seq].srejSent) return 0;
+    if (sendSupervisionFrame(conn, responseControl(conn, RESPONSE_SREJ, seq)) == -1) return -1;
+    conn->rxWindow[seq].srejSent = TRUE;
+    return 0;
+}
+
+/**
+ * Delivers the frame waiting in the reorder buffer for expectedSeq, if it already arrived (Selective Repeat)
+ * returns number of bytes copied into packet
+ *         0 if the frame is not in the reorder buffer
+**/
+int deliverBufferedFrame(LinkConnection* conn, unsigned char* packet) {
+    ReorderSlot* slot = &conn->rxWindow[conn->expectedSeq];
+    if (!slot->received) return 0;
+
+    int size = slot->size;
+    memcpy(packet, slot->data, size);
+    slot->received = FALSE;
+    slot->srejSent = FALSE;
+    conn->expectedSeq = (conn->expectedSeq + 1) % conn->modulus;
+    return size;
+}
+
+/**
+ * Handles an I frame with a valid BCC2 (Selective Repeat)
+ * The expected frame goes straight to packet, frames ahead of it wait in the reorder buffer.
+ * returns number of bytes copied into packet
+ *         0 if nothing can be delivered yet (out of order or duplicate frame)
+ *        -1 on error
+**/
+int receiveSelectiveRepeatFrame(LinkConnection* conn, int ns, unsigned char* data, int size, unsigned char* packet) {
+    int distance = (ns - conn->expectedSeq + conn->modulus) % conn->modulus;
+    conn->totalNumOfFrames++;
+
+    // Case - Frame is behind the receive window, its RR was lost (Discard and acknowledge again)
+    if (distance >= conn->windowSize) {
+        conn->totalNumOfDuplicateFrames++;
+        return sendSupervisionFrame(conn, responseControl(conn, RESPONSE_RR, firstMissingSeq(conn)));
+    }
+
+    // Case - Frame is already waiting in the reorder buffer (Discard)
+    if (conn->rxWindow[ns].received) {
+        conn->totalNumOfDuplicateFrames++;
+        return 0;
+    }
 
-            if (bytesWritten == 5) {
-                alarm(timeout); // Set alarm to be triggered after timeout
-                alarmEnabled = TRUE;
-                int csu = checkSUFrame(CONTROL_UA, &alarmEnabled);
-                if (csu == -1) {
-                    printf("%s: An error occoures inside checkSUFrame.\n", __func__);
-                    return -1;   
-                }
-                else if (alarmEnabled){
-                    alarm(0);
-                    alarmEnabled = FALSE;
-                    alarmCount = 0;
-                    return 1;   
-                } 
-            }
-            totalNumOfRetransmissions++;
-        }
-    } else if (role == LlRx) { // Receiver
-        int enterCheckSUFrame = TRUE;
-        while (enterCheckSUFrame) {
-            int csu = checkSUFrame(CONTROL_SET, &enterCheckSUFrame);
+    conn->totalNumOfValidFrames++;
 
-            if (csu == -1) {
-                printf("%s: An error occurred inside checkSUFrame.\n", __func__);
-                return -1;
-            }
+    // Case - Frame is the expected one (Accept)
+    if (distance == 0) {
+        if (data != packet) memcpy(packet, data, size);
+        conn->rxWindow[ns].srejSent = FALSE;
+        conn->expectedSeq = (conn->expectedSeq + 1) % conn->modulus;
+        if (acknowledgeFrame(conn) == -1) return -1;
+        return size;
+    }
 
-            int BCC1 = ADDRESS_SENT_BY_TX ^ CONTROL_UA;
-            unsigned char ua_array[5] = {FLAG, ADDRESS_SENT_BY_TX, CONTROL_UA, BCC1, FLAG};
+    // Case - Frame is ahead of the expected one (Keep it and ask for the missing ones)
+    memcpy(conn->rxWindow[ns].data, data, size);
+    conn->rxWindow[ns].size = size;
+    conn->rxWindow[ns].received = TRUE;
+    conn->totalNumOfOutOfSequenceFrames++;
 
-            int wb = writeBytes(ua_array, 5);
-            if (wb == -1) {
-                printf("%s: An error occurred inside writeBytes.\n", __func__);
-                return -1;
-            } 
-            else if (wb == 5) return 1;
-            else { 
-                totalNumOfRetransmissions++; 
-                continue;
-            }
-        }
+    // The frames before the gap are acknowledged right away
+    if (flushAck(conn) == -1) return -1;
+    for (int seq = conn->expectedSeq; seq != ns; seq = (seq + 1) % conn->modulus) {
+        if (sendSelectiveReject(conn, seq) == -1) return -1;
     }
-    return -1;
+    return 0;
 }
 
-////////////////////////////////////////////////
-// LLWRITE
-////////////////////////////////////////////////
 /**
- * Reads an I frame response (ACK or NACK) to determine which frame to send next
- * returns 0 on valid frame
- *         1 on invalid frame
- *        -1 on error
+ * Corrects the data field of an FEC frame in place and checks its FCS
+ * event - I frame, its size is set to the number of data bytes
+ * returns 0 on success
+ *        -1 if the frame can not be corrected
 */
-int readIFrameResponse() {
-    state_t state = START;
-    unsigned char BCC1 = 0x00;
-    unsigned char byte;
-    int isInvalid = 0;
-
-    while (state != STOP_STATE && alarmEnabled) {
-        int rb = readByte(&byte);
-        if (rb == -1) return -1;
-        if (rb == 0) continue;
-        switch (state) {
-            case START:
-                state = byte == FLAG ? FLAG_RCV : START;
-                break;
-            case FLAG_RCV:
-                state = byte == FLAG ? FLAG_RCV : (byte == ADDRESS_SENT_BY_TX ? A_RCV : START);
-                break;
-            case A_RCV:
-                switch (byte) {
-                    case CONTROL_RR0:
-                        totalNumOfValidFrames++;
-                        state = C_RCV;
-                        CFieldToSendNext = 0;
-                        break;
-                    case CONTROL_RR1:
-                        totalNumOfValidFrames++;
-                        state = C_RCV;
-                        CFieldToSendNext = 1;
-                        break;
-                    case CONTROL_REJ0:
-                        totalNumOfInvalidFrames++;
-                        isInvalid = 1;
-                        state = C_RCV;
-                        break;
-                    case CONTROL_REJ1:
-                        totalNumOfInvalidFrames++;
-                        isInvalid = 1;
-                        state = C_RCV;
-                        break;
-                    case FLAG:
-                        state = FLAG_RCV; 
-                        break;                    
-                    default:
-                        state = START;
-                        break;
-                }
-                BCC1 = ADDRESS_SENT_BY_TX ^ byte;
-                break;
-            case C_RCV:
-                state = byte == FLAG ? FLAG_RCV : (byte == BCC1 ? BCC_OK : START);
-                break;
-            case BCC_OK:
-                state = byte == FLAG ? STOP_STATE : START;
-                break;
-            case STOP_STATE:
-                break;
-            default:
-                state = START;
-                break;
-        }
+int correctFrame(LinkConnection* conn, FrameEvent* event) {
+    int corrected = 0;
+    int size = fecDecode(event->data, event->size, conn->fecParity, &corrected) - fcsSize(conn->fcsType);
+    if (size < 0 || size > MAX_PAYLOAD_SIZE) return -1;
+
+    unsigned char fcs[FCS_MAX_SIZE];
+    computeFcs(conn->fcsType, event->data, size, fcs);
+    if (memcmp(fcs, event->data + size, fcsSize(conn->fcsType)) != 0) return -1;
+
+    if (corrected > 0) {
+        conn->totalNumOfCorrectedFrames++;
+        conn->totalNumOfCorrectedBytes += corrected;
     }
-    return isInvalid;
+    event->size = size;
+    return 0;
 }
 
 /**
- * Function that tx uses to write frames to the serial port 
- * buf - frame to write to serial port (before byte stuffing)
- * bufSize - Size of the frame to write to serial port (before byte stuffing)
- * returns number of data bytes written (without byte stuffing) on success
+ * Handles a frame sent by the other end while this end receives I frames
+ * event - frame received (the address was checked by the caller)
+ * packet - buffer the data of an accepted I frame is copied into (NULL if there is no room for it,
+ *          the other end sends the frame again)
+ * returns number of data bytes copied into packet
+ *         0 if nothing is delivered (not an I frame, rejected, duplicate, out of sequence or buffered)
  *        -1 on error
 */
-int llwrite(const unsigned char *buf, int bufSize) {
-    if (bufSize < 0 || buf == NULL) return -1;    
-    
-    int newFrameSize = bufSize + 6;
-    int numBytesStuffed = 0;
-    for (int i = 0; i < bufSize; i++) { // Get the new frame size for byte stuffing
-        if (buf[i] == FLAG || buf[i] == ESCAPE_OCTET) {
-            numBytesStuffed++;
-            newFrameSize++;
+int receiveIFrame(LinkConnection* conn, FrameEvent* event, unsigned char* packet) {
+    int receivedSeq = 0;
+
+    // Case - Tx did not get the UA (Send it again, negotiated if tx offers its parameters after rx fell back)
+    if (event->type != FRAME_BAD_BCC1 && event->control == CONTROL_SET) {
+        LinkParameters offer;
+        if (conn->legacyFallback && event->type != FRAME_SU && decodeLateParameters(conn, event, &offer) == 0) {
+            if (answerOffer(conn, &offer) == -1) return -1;
+            conn->legacyFallback = FALSE;
+            printf("%s: Tx offered its parameters again, leaving the original protocol.\n", __func__);
         }
+        if (writeFrame(conn, conn->uaFrame, conn->uaFrameSize) == -1) return -1;
+        return 0;
     }
 
-    unsigned char* frame = (unsigned char*)malloc(sizeof(unsigned char) * (newFrameSize));
-
-    frame[0] = FLAG; 
-    frame[1] = ADDRESS_SENT_BY_TX;
+    // Case - Tx is done and waits for the DISC of rx (duplex, rx still has frames to drain)
+    if (event->type == FRAME_SU && event->control == CONTROL_DISC) {
+        conn->discReceived = TRUE;
+        return 0;
+    }
 
-    if (CFieldToSendNext) frame[2] = 0x80; // Send frame 1 next
-    else frame[2] = 0x00; // Send frame 0 next
-    
-    frame[3] = frame[1] ^ frame[2];
+    // Case - The other end polls (Answer right away, the poll acknowledges frames too in duplex)
+    int nr;
+    if (event->type == FRAME_SU && decodePollFinalControl(conn, event->control, &nr)) {
+        if (conn->duplex) acknowledgeUpTo(conn, nr);
+        conn->rejSent = FALSE; // Tx timed out, the frames it sends again after the answer get their own REJ
+        return sendFinal(conn) == -1 ? -1 : 0;
+    }
 
-    // Byte Stuffing
-    int j = 0;
-    for (int i = 0; i < bufSize; i++) {
-        if (buf[i] == FLAG || buf[i] == ESCAPE_OCTET){
-            frame[4 + j] = ESCAPE_OCTET;
-            j++;
-            frame[4 + j] = buf[i] ^ ESCAPE_XOR; // Do the XOR
-        } else {
-            frame[4 + j] = buf[i];
+    // Case - Header is not from an I frame or BCC1 is invalid (Discard)
+    if (event->type == FRAME_SU || event->type == FRAME_BAD_BCC1 || !decodeIFrameControl(conn, event->control, &receivedSeq)) return 0;
+    conn->legacyFallback = FALSE; // Tx kept the original protocol
+
+    // FEC frames: fix the errors before they are checked
+    if (event->type == FRAME_I && conn->fecParity > 0 && correctFrame(conn, event) == -1) event->type = FRAME_BAD_BCC2;
+
+    // Case - FCS is invalid or the data is too big (Reject)
+    if (event->type == FRAME_BAD_BCC2) {
+        if (conn->arqMode == ARQ_SELECTIVE_REPEAT) { // SEND SREJ (the header is valid, so only this frame is asked for)
+            if (flushAck(conn) == -1) return -1;
+            if ((receivedSeq - conn->expectedSeq + conn->modulus) % conn->modulus < conn->windowSize && sendSelectiveReject(conn, receivedSeq) == -1) return -1;
+        } else if (!conn->rejSent || receivedSeq == conn->expectedSeq || conn->windowSize == 1) {
+            // SEND NACK (asks for the frame rx is waiting for: once per lost frame in Go-Back-N, again when it arrives damaged once more)
+            if (sendSupervisionFrame(conn, responseControl(conn, RESPONSE_REJ, conn->expectedSeq)) == -1) return -1;
+            conn->rejSent = TRUE;
+            ackSent(conn); // REJ acknowledges the frames before expectedSeq
         }
-        j++;
+        conn->totalNumOfFrames++;
+        conn->totalNumOfInvalidFrames++;
+        return 0;
     }
 
-    unsigned char BCC2 = buf[0];
-    for (int j = 1; j < bufSize; j++) {
-        BCC2 ^= buf[j]; 
-    }
+    // Acknowledgement piggybacked on the frame (duplex, only trusted once the whole frame is checked)
+    if (conn->duplex) acknowledgeUpTo(conn, CONTROL_I_NR(event->control));
+    if (packet == NULL) return 0;
 
-    // BCC2 byte stuffing
-    if (BCC2 == FLAG || BCC2 == ESCAPE_OCTET) {
-        frame = (unsigned char*)realloc(frame, newFrameSize + sizeof(unsigned char) * 2);
-        newFrameSize++;
-        frame[newFrameSize - 3] = ESCAPE_OCTET;
-        frame[newFrameSize - 2] = BCC2 ^ ESCAPE_XOR;
-        numBytesStuffed++;
-    } else {
-        frame[newFrameSize - 2] = BCC2;
-    }
+    if (conn->arqMode == ARQ_SELECTIVE_REPEAT) return receiveSelectiveRepeatFrame(conn, receivedSeq, event->data, event->size, packet);
 
-    frame[newFrameSize - 1] = FLAG;    
+    int distance = (receivedSeq - conn->expectedSeq + conn->modulus) % conn->modulus;
 
-    int wb = 0;
-    
-    if (signal(SIGALRM, alarmHandler) == SIG_ERR) {
-        printf("%s: An error occurred inside signal.\n", __func__);
-        return -1;
+    // Case - Frame is a duplicate (Accept and discard)
+    if (distance != 0 && conn->windowSize == 1){
+        sendAck(conn); 
+        conn->totalNumOfFrames++;
+        conn->totalNumOfDuplicateFrames++;
+        return 0;
     }
-    alarm(0);
-
-    alarmCount = 0;
-    alarmEnabled = FALSE;
 
-    int previousCFieldToSendNext = CFieldToSendNext;
+    // Case - Frame is out of sequence, a previous frame was lost or this is a retransmission (Discard, Go-Back-N)
+    // Only one REJ is sent until the expected frame arrives (or tx polls).
+    if (distance != 0) {
+        if (!conn->rejSent) {
+            if (sendSupervisionFrame(conn, responseControl(conn, RESPONSE_REJ, conn->expectedSeq)) == -1) return -1;
+            conn->rejSent = TRUE;
+            ackSent(conn);
+        }
+        conn->totalNumOfFrames++;
+        conn->totalNumOfOutOfSequenceFrames++;
+        return 0;
+    }
 
-    while (alarmCount < numberOfRetransmitions) { 
-        if (alarmEnabled == FALSE){
-            int bytesWritten = writeBytes(frame, newFrameSize);
-            totalNumOfFrames++;
+    // Case - Frame accepted (Accept, the data was destuffed straight into packet unless FEC is on)
+    if (event->data != packet) memcpy(packet, event->data, event->size);
+    conn->expectedSeq = (conn->expectedSeq + 1) % conn->modulus;
+    conn->rejSent = FALSE;
+    if (acknowledgeFrame(conn) == -1) return -1;
+    conn->totalNumOfFrames++;
+    conn->totalNumOfValidFrames++;
+    return event->size;
+}
 
-            if (bytesWritten == -1) {
-                printf("%s: An error occurred inside writeBytes.\n", __func__);
+/**
+ * Reads frames until an I frame is delivered (its data is destuffed straight into packet)
+ * packet - buffer to read the frame data into
+ * wait - FALSE gives up once the bytes that already arrived are used up
+ * returns number of data bytes read on success
+ *         0 if wait is FALSE and no frame could be delivered
+ *        -1 on error
+*/
+int readIFrame(LinkConnection* conn, unsigned char* packet, int wait) {
+    while (TRUE) {
+        FrameEvent event;
+        int rf = readFrame(conn, &event);
+        if (rf == -1) return -1;
+        if (rf == 0) { // Sleep until more bytes arrive or the delayed acknowledgement is due
+            if (timerExpired(&conn->ackTimer) && flushAck(conn) == -1) return -1;
+            if (!wait) return 0;
+            if (waitForFrames(conn) == -1) {
+                printf("%s: An error occurred inside waitForFrames.\n", __func__);
                 return -1;
-            } else {
-                int response = 0;
-                alarm(timeout); // Set alarm
-                alarmEnabled = TRUE;
-                if ((response = readIFrameResponse()) == -1) {
-                    printf("%s: An error occured in readIFrameResponse.\n", __func__);
-                    return -1;
-                }
-
-                if (response == 1) { // REJ 
-                    alarm(0);
-                    alarmEnabled = FALSE;
-                    alarmCount = 0;
-                }
-
-                if (response == 0 && (previousCFieldToSendNext != CFieldToSendNext)) {
-                    alarm(0);
-                    wb = bytesWritten - 6 - numBytesStuffed;
-                    alarmEnabled = FALSE;
-                    alarmCount = 0;
-                    break;
-                }
             }
-
-            totalNumOfRetransmissions++;
+            continue;
         }
+        if (event.address != conn->receiveAddress) continue;
+
+        int size = receiveIFrame(conn, &event, packet);
+        if (size != 0) return size;
     }
 
-    free(frame);
+    printf("%s: An error occurred.\n", __func__);
+    return -1;
+}
 
-    // Return number of writer characters
-    return wb;
+/**
+ * Handles a frame of the other end that arrived while this end was sending (duplex)
+ * Accepted frames wait in the delivery queue, a full queue drops them (their acknowledgement is still used).
+ * returns 0 on success
+ *        -1 on error
+*/
+int queueIFrame(LinkConnection* conn, FrameEvent* event) {
+    ReorderSlot* slot = &conn->deliveryQueue[(conn->queueHead + conn->queueCount) % MAX_MODULUS];
+    int size = receiveIFrame(conn, event, conn->queueCount < MAX_MODULUS ? slot->data : NULL);
+    if (size == -1) return -1;
+    if (size > 0) {
+        slot->size = size;
+        conn->queueCount++;
+    }
+    return 0;
 }
 
-////////////////////////////////////////////////
-// LLREAD
-////////////////////////////////////////////////
 /**
- * Helper function that sends an ACK to Tx.
- * The function should get the values that is inside the frame and use it to respond to Tx.
- * 
- * This way if Tx sends frame 0, Rx should tell Tx that it wants frame 1.
- * 
- * returns void
- * 
-**/
-void sendAck(unsigned char receivedCField) {
-    unsigned char prevCFieldChar = prevCField ? I_FRAME_1 : I_FRAME_0; // If previous C Field is 1, then previous C Field Char is I_FRAME_1 (0x80).
-    unsigned char RR = 0x00;
-    if (receivedCField == prevCFieldChar){ // Frame is duplicate
-        RR = prevCField ? CONTROL_RR0 : CONTROL_RR1;
+ * Number of frames llread can deliver without waiting (duplex)
+*/
+int deliverableFrames(LinkConnection* conn) {
+    int count = conn->queueCount;
+    if (conn->arqMode == ARQ_SELECTIVE_REPEAT) {
+        int seq = conn->expectedSeq;
+        for (int i = 0; i < conn->windowSize && conn->rxWindow[seq].received; i++) {
+            seq = (seq + 1) % conn->modulus;
+            count++;
+        }
     }
-    else {
-        if (receivedCField == I_FRAME_0) {
-            RR = CONTROL_RR1;
-            prevCField = 0;
+    return count;
+}
+
+/**
+ * Waits for the next frame of the other end while the frames this end sent are serviced (duplex)
+ * packet - buffer to read the frame data into
+ * returns number of data bytes read on success
+ *        -1 on error
+*/
+int readDuplexFrame(LinkConnection* conn, unsigned char* packet) {
+    while (TRUE) {
+        if (conn->queueCount > 0) { // Oldest frame of the delivery queue
+            ReorderSlot* slot = &conn->deliveryQueue[conn->queueHead];
+            memcpy(packet, slot->data, slot->size);
+            conn->queueHead = (conn->queueHead + 1) % MAX_MODULUS;
+            conn->queueCount--;
+            return slot->size;
         }
-        else {
-            RR = CONTROL_RR0;
-            prevCField = 1;
+        if (conn->arqMode == ARQ_SELECTIVE_REPEAT) { // Frames that arrived early come after the queued ones
+            int bufferedSize = deliverBufferedFrame(conn, packet);
+            if (bufferedSize > 0) return bufferedSize;
         }
-    }
 
-    // Conditions
-    unsigned char BCC1 = RR ^ ADDRESS_SENT_BY_TX;
+        if (processFrames(conn) == -1) return -1;
+        if (deliverableFrames(conn) > 0) continue;
+        if (checkTimers(conn) == -1) return -1;
 
-    // Send ACK
-    unsigned char ua_array[5] = {FLAG, ADDRESS_SENT_BY_TX, RR, BCC1, FLAG};
-    if (writeBytes(ua_array, 5) == -1) {
-        printf("%s: An error occurred in writeBytes\n", __func__);
-    } 
+        // Sleep until a frame arrives or a timer expires
+        if (flushAck(conn) == -1) return -1;
+        if (waitForFrames(conn) == -1) {
+            printf("%s: An error occurred inside waitForFrames.\n", __func__);
+            return -1;
+        }
+    }
 }
 
 /**
@@ -441,206 +1867,337 @@ void sendAck(unsigned char receivedCField) {
  * returns number of data bytes read on success
  *        -1 on error
 **/
-int llread(unsigned char *packet) {
+int ll_read(LinkConnection* conn, unsigned char *packet) {
     if (packet == NULL) {
         printf("%s: An error occurred, packet is NULL\n", __func__);
         return -1;
     }
+    if (conn->duplex) return readDuplexFrame(conn, packet);
+
+    if (conn->arqMode == ARQ_SELECTIVE_REPEAT) { // Frames that arrived early are delivered first
+        int bufferedSize = deliverBufferedFrame(conn, packet);
+        if (bufferedSize > 0) return bufferedSize;
+    }
 
-    int state = START;
-    unsigned char* dataFrame = (unsigned char *)malloc(sizeof(unsigned char)); // The data from the information frame will be stored here.
-    int currentDataFrameIt = 0;
-    unsigned char receivedCField = 0x00;
+    if (conn->fecParity == 0) setFrameParserOutput(&conn->parser, packet, MAX_PAYLOAD_SIZE); // FEC frames do not fit in packet
+    int size = readIFrame(conn, packet, TRUE);
+    setFrameParserOutput(&conn->parser, NULL, 0); // packet belongs to the caller
+    return size;
+}
 
-    while (state != STOP_STATE) {
-        unsigned char byte = 0;
-        int rb = 0;
-        if ((rb = readByte(&byte)) == -1) {
-            printf("%s: An error occurred in readByte.\n", __func__);
+/**
+ * Reads the next packet, then the ones that already arrived (up to maxPackets)
+ * Only the first packet is waited for, the others are the frames the serial port already holds.
+ * packets - buffers to read the data of each packet into
+ * sizes - number of data bytes of each packet read
+ * returns number of packets read on success
+ *        -1 on error
+**/
+int ll_readBatch(LinkConnection* conn, unsigned char *packets[], int sizes[], int maxPackets) {
+    if (packets == NULL || sizes == NULL || maxPackets < 1) return -1;
+    for (int i = 0; i < maxPackets; i++) {
+        if (packets[i] == NULL) {
+            printf("%s: An error occurred, packet %d is NULL\n", __func__, i);
             return -1;
         }
-        if (rb == 0) continue;
-
-        unsigned char BCC1 = 0x00; 
-    
-        switch (state) {
-            case START:
-                if (byte == FLAG) state = FLAG_RCV;
-                break;
-            case FLAG_RCV:
-                state = byte == FLAG ? FLAG_RCV : (byte == ADDRESS_SENT_BY_TX ? A_RCV : START);
-                break;
-            case A_RCV:
-                receivedCField = byte;
-                if (byte == FLAG) state = FLAG_RCV;
-                else if ((byte == I_FRAME_0) || (byte == I_FRAME_1)) state = C_RCV;
-                else state = START;
-                break;
-            case C_RCV:
-                BCC1 = ADDRESS_SENT_BY_TX ^ receivedCField;
-                state = byte == FLAG ? FLAG_RCV : (byte == BCC1 ? BCC_OK : START);
-                break;
-            case BCC_OK:
-                dataFrame[currentDataFrameIt] = byte;
-                currentDataFrameIt++;
-                dataFrame = (unsigned char*)realloc(dataFrame, (currentDataFrameIt + 1) * sizeof(unsigned char));
+    }
 
-                if (dataFrame == NULL) {
-                    printf("%s: An error occurred while doing realloc, dataFrame is NULL.\n", __func__);
-                    return -1;
-                }
+    int size = ll_read(conn, packets[0]);
+    if (size == -1) return -1;
+    sizes[0] = size;
 
-                // When byte is equal to flag -> Stop reading data and go check the data we received.
-                if (byte == FLAG){
-                    state = CHECK_DATA;
-                }   
+    int count = 1;
+    while (count < maxPackets) {
+        if (conn->duplex) {
+            int available = ll_readAvailable(conn);
+            if (available == -1) return -1;
+            size = available > 0 ? readDuplexFrame(conn, packets[count]) : 0;
+        } else {
+            size = conn->arqMode == ARQ_SELECTIVE_REPEAT ? deliverBufferedFrame(conn, packets[count]) : 0;
+            // The parser keeps its own output here: the frame it is halfway through when the bytes
+            // run out must not be destuffed into a packet that was already given back
+            if (size == 0) size = readIFrame(conn, packets[count], FALSE);
         }
+        if (size == -1) return -1;
+        if (size == 0) break;
+        sizes[count++] = size;
+    }
+    return count;
+}
 
-        if (state == CHECK_DATA) {
-            int data_bcc2_flag_size = currentDataFrameIt;
-            unsigned char* actualData = (unsigned char*)malloc(sizeof(unsigned char));
-            int actualDataIt = 0;
-            int sizeOfActualData = 1;
-            int expectDestuffing = FALSE;
-            for (int i = 0; i < (data_bcc2_flag_size - 1); i++) { // Byte destuffing
-
-                if (actualDataIt != 0) {
-                    sizeOfActualData++;
-                    actualData = (unsigned char*)realloc(actualData, sizeOfActualData * sizeof(unsigned char));
-                }
+/**
+ * Number of data packets llread returns without waiting
+ * In duplex the frames that already arrived are handled first, so an application that mostly writes
+ * can empty the queue now and then (the other end stalls once it is full). Always 0 otherwise.
+*/
+int ll_readAvailable(LinkConnection* conn) {
+    if (!conn->duplex) return 0;
+    if (processFrames(conn) == -1) return -1;
+    return deliverableFrames(conn);
+}
 
-                if (dataFrame[i] != ESCAPE_OCTET) {
-                    actualData[actualDataIt] = dataFrame[i];
-                    actualDataIt++;
-                } else {
-                    // We know that the current byte is not to be added
-                    // And we take the next byte, xor it and add it to the actualData
-                    if (i + 1 > (data_bcc2_flag_size - 1)) {
-                        printf("%s: An error occurred inside the byte destuffing.\n", __func__);
-                        return -1;
-                    }
-                    i++;
-                    actualData[actualDataIt] = (dataFrame[i] ^ ESCAPE_XOR);
-                    actualDataIt++;
-                }
+////////////////////////////////////////////////
+// ASYNCHRONOUS INTERFACE
+////////////////////////////////////////////////
+/**
+ * Waits for the serial port only while it has something to do: tx (and duplex) always handle the
+ * responses, rx leaves the I frames in the port until a read is submitted (the other end then waits
+ * for its acknowledgements, as it does while the application of a blocking rx is busy)
+ * With an io_uring the same goes for the ring, whose read in flight takes the bytes out of the port.
+ * returns 0 on success
+ *        -1 on error
+*/
+int watchPort(LinkConnection* conn) {
+    int events = (conn->role == LlTx || conn->duplex || conn->readRequests.count > 0) ? EPOLLIN : 0;
+    if (events == conn->portEvents) return 0;
+
+    struct epoll_event event = {.events = events, .data.fd = conn->port.fd};
+    if (epoll_ctl(conn->epollFd, EPOLL_CTL_MOD, conn->port.fd, &event) == -1) return -1;
+    if (conn->ioRing != NULL) {
+        struct epoll_event ringEvent = {.events = events, .data.fd = conn->ioRing->fd};
+        if (epoll_ctl(conn->epollFd, EPOLL_CTL_MOD, conn->ioRing->fd, &ringEvent) == -1) return -1;
+    }
+    conn->portEvents = events;
+    return 0;
+}
 
-            }
+int ll_eventFd(LinkConnection* conn) {
+    if (conn == NULL) return -1;
+    if (conn->epollFd != -1) return conn->epollFd;
 
-            // Check BCC2
-            unsigned char dataAccm = 0x00;
+    conn->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (conn->epollFd == -1) {
+        printf("%s: An error occurred in epoll_create1.\n", __func__);
+        return -1;
+    }
+    struct epoll_event timerEvent = {.events = EPOLLIN, .data.fd = conn->timers.timerFd};
+    struct epoll_event portEvent = {.events = 0, .data.fd = conn->port.fd};
+    // With an io_uring the read in flight takes the bytes as they arrive, so the port may never look
+    // readable: the ring is, once the read (or a write) completes
+    struct epoll_event ringEvent = {.events = 0, .data.fd = conn->ioRing != NULL ? conn->ioRing->fd : -1};
+    if (epoll_ctl(conn->epollFd, EPOLL_CTL_ADD, conn->timers.timerFd, &timerEvent) == -1 ||
+        epoll_ctl(conn->epollFd, EPOLL_CTL_ADD, conn->port.fd, &portEvent) == -1 ||
+        (conn->ioRing != NULL && epoll_ctl(conn->epollFd, EPOLL_CTL_ADD, conn->ioRing->fd, &ringEvent) == -1) ||
+        watchPort(conn) == -1 || armTimers(&conn->timers) == -1) {
+        printf("%s: An error occurred while watching the serial port and the timers.\n", __func__);
+        close(conn->epollFd);
+        conn->epollFd = -1;
+        return -1;
+    }
+    return conn->epollFd;
+}
 
-            for (int i = 0; i < sizeOfActualData-1; i++) {
-                dataAccm ^= actualData[i];  // EXOR all the destuffed data bytes
-            }
+/**
+ * Queues a request and wakes up the event loop, so the next ll_poll handles it
+ * returns 0 on success
+ *        -1 if the queue is full (or on error)
+*/
+int submitRequest(LinkConnection* conn, AsyncQueue* queue, AsyncRequest request) {
+    if (queue->count == MAX_ASYNC_REQUESTS) return -1;
+    queue->requests[(queue->head + queue->count) % MAX_ASYNC_REQUESTS] = request;
+    queue->count++;
 
-            // Case - XOR is invalid or the data is too big (Reject)
-            if (dataAccm != actualData[actualDataIt-1] || (sizeOfActualData-1) > MAX_PAYLOAD_SIZE) { // If dataAccm is not the same as BCC2, something went wrong
+    startTimer(&conn->timers, &conn->wakeTimer, 0);
+    if (conn->epollFd != -1 && (watchPort(conn) == -1 || armTimers(&conn->timers) == -1)) return -1;
+    return 0;
+}
 
-                unsigned char REJ = 0x00;
-                if (prevCField == 0) REJ = CONTROL_REJ0;
-                else REJ = CONTROL_REJ1;
+/**
+ * Removes the oldest request of a queue and calls its callback
+ * result - number of data bytes written or read, -1 if the request failed
+*/
+void completeRequest(LinkConnection* conn, AsyncQueue* queue, int result) {
+    AsyncRequest request = queue->requests[queue->head];
+    queue->head = (queue->head + 1) % MAX_ASYNC_REQUESTS;
+    queue->count--;
+    if (request.callback != NULL) request.callback(conn, result, request.arg);
+}
 
-                unsigned char BCC1 = REJ ^ ADDRESS_SENT_BY_TX; 
+int ll_submitWrite(LinkConnection* conn, const unsigned char *buf, int bufSize, LinkCallback callback, void *arg) {
+    if (conn == NULL || buf == NULL || bufSize < 0 || bufSize > conn->maxPayloadSize) return -1;
+    if (conn->role != LlTx && !conn->duplex) return -1; // Rx has no transmission window
+    return submitRequest(conn, &conn->writeRequests, (AsyncRequest){buf, NULL, bufSize, callback, arg});
+}
 
-                // SEND NACK
-                unsigned char ua_array[5] = {FLAG, ADDRESS_SENT_BY_TX, REJ, BCC1, FLAG};
-                if (writeBytes(ua_array, 5) == -1){
-                    printf("%s: An error occurred in writeBytes\n", __func__);
-                    return -1;
-                }
-                state = START;
-
-                // Clean allocated space
-                free(dataFrame);
-                dataAccm = 0;
-                currentDataFrameIt = 0;
-                dataFrame = (unsigned char *)malloc(sizeof(unsigned char)); // The data from the information frame will be stored here.
-                
-                free(actualData);
-                actualData = (unsigned char*)malloc(sizeof(unsigned char));
-                actualDataIt = 0;
-                sizeOfActualData = 1;
-                totalNumOfFrames++;
-                totalNumOfInvalidFrames++;
-            } else { 
-                unsigned char prevCFieldChar = prevCField ? I_FRAME_1 : I_FRAME_0;
-                // Case - Frame is a duplicate (Accept and discard)
-                if (prevCFieldChar == receivedCField){
-                    sendAck(receivedCField); 
-                    free(dataFrame);
-                    free(actualData);
-                    totalNumOfFrames++;
-                    totalNumOfDuplicateFrames++;
-                    return 0;
-                }
+int ll_submitRead(LinkConnection* conn, unsigned char *packet, LinkCallback callback, void *arg) {
+    if (conn == NULL || packet == NULL) return -1;
+    if (conn->role != LlRx && !conn->duplex) return -1; // Tx receives no I frames
+    return submitRequest(conn, &conn->readRequests, (AsyncRequest){NULL, packet, 0, callback, arg});
+}
 
-                // Case - Frame accepted (Accept)
-                for (int i = 0; i < sizeOfActualData; i++) {
-                    packet[i] = (unsigned char)actualData[i]; 
-                }
+/**
+ * Sends the queued writes while the window has room for them
+ * returns number of requests completed
+ *        -1 on error
+*/
+int completeWrites(LinkConnection* conn) {
+    int completed = 0;
+    AsyncQueue* queue = &conn->writeRequests;
+    while (queue->count > 0 && outstandingFrames(conn) < conn->windowSize) {
+        AsyncRequest* request = &queue->requests[queue->head];
+        struct iovec iov = {(void*)request->data, request->size};
+        if (sendIFrame(conn, &iov, 1, request->size) == -1) return -1;
+        completeRequest(conn, queue, request->size);
+        completed++;
+    }
+    return completed;
+}
 
-                sendAck(receivedCField); 
-                totalNumOfFrames++;
-                totalNumOfValidFrames++;
-                return sizeOfActualData;
-            }
+/**
+ * Delivers the frames that already arrived to the queued reads
+ * The parser keeps its own output: a frame it is halfway through must not be destuffed into a
+ * packet that may be given back before the frame ends (SR delivers buffered frames meanwhile).
+ * returns number of requests completed
+ *        -1 on error
+*/
+int completeReads(LinkConnection* conn) {
+    int completed = 0;
+    AsyncQueue* queue = &conn->readRequests;
+    while (queue->count > 0) {
+        unsigned char* packet = queue->requests[queue->head].packet;
+        int size;
+        if (conn->duplex) size = deliverableFrames(conn) > 0 ? readDuplexFrame(conn, packet) : 0;
+        else {
+            size = conn->arqMode == ARQ_SELECTIVE_REPEAT ? deliverBufferedFrame(conn, packet) : 0;
+            if (size == 0) size = readIFrame(conn, packet, FALSE);
         }
+        if (size == -1) return -1;
+        if (size == 0) break;
+        completeRequest(conn, queue, size);
+        completed++;
     }
+    return completed;
+}
 
-    printf("%s: An error occurred.\n", __func__);
-    return -1;
+/**
+ * Does everything the link can do without blocking: handles the frames and timers, then completes
+ * the requests that can be (their callbacks may submit new ones)
+ * returns number of requests completed
+ *        -1 on error
+*/
+int asyncStep(LinkConnection* conn) {
+    stopTimer(&conn->wakeTimer);
+    if (conn->role == LlTx || conn->duplex) { // Responses, duplex I frames and retransmissions
+        if (processFrames(conn) == -1) return -1;
+        if (checkTimers(conn) == -1) return -1;
+    }
+    if (timerExpired(&conn->ackTimer) && flushAck(conn) == -1) return -1;
+
+    int written = completeWrites(conn);
+    if (written == -1) return -1;
+    int read = completeReads(conn);
+    if (read == -1) return -1;
+    return written + read;
+}
+
+/**
+ * The link failed: every queued request completes with -1
+*/
+void failRequests(LinkConnection* conn) {
+    while (conn->writeRequests.count > 0) completeRequest(conn, &conn->writeRequests, -1);
+    while (conn->readRequests.count > 0) completeRequest(conn, &conn->readRequests, -1);
+}
+
+int ll_poll(LinkConnection* conn, int timeoutMs) {
+    if (ll_eventFd(conn) == -1) return -1;
+    double deadline = nowMs() + timeoutMs;
+    int completed = 0;
+
+    while (TRUE) {
+        int done;
+        while ((done = asyncStep(conn)) > 0) completed += done;
+
+        // The other end may wait for an acknowledgement before it sends anything else (see serviceWindow),
+        // and the event fd must wake up the loop for the next timer (or for the bytes of the ring read, which
+        // is submitted here since this does not wait on the ring)
+        if (done == -1 || (conn->duplex && flushAck(conn) == -1) || watchPort(conn) == -1 || armTimers(&conn->timers) == -1 ||
+            (conn->ioRing != NULL && ioRingSubmit(conn->ioRing) == -1)) {
+            printf("%s: The link failed, the queued requests are dropped.\n", __func__);
+            failRequests(conn);
+            return -1;
+        }
+        if (completed > 0 || timeoutMs == 0) return completed;
+        if (conn->writeRequests.count == 0 && conn->readRequests.count == 0) return 0; // Nothing to wait for
+
+        int waitMs = -1;
+        if (timeoutMs > 0) {
+            if (msUntil(deadline) == 0) return 0;
+            waitMs = (int)msUntil(deadline) + 1;
+        }
+        struct epoll_event events[2];
+        if ((epoll_wait(conn->epollFd, events, 2, waitMs) == -1 && errno != EINTR) || clearTimers(&conn->timers) == -1) {
+            printf("%s: An error occurred while waiting for events.\n", __func__);
+            failRequests(conn);
+            return -1;
+        }
+    }
 }
 
+
 ////////////////////////////////////////////////
 // LLCLOSE
 ////////////////////////////////////////////////
-int llclose(int showStatistics) {
-    if (showStatistics) printf("Statistics:\n");
-    if (role == LlTx) { // Transmitter
-        while (alarmCount < numberOfRetransmitions) {
+int closeConnection(LinkConnection* conn, int showStatistics) {
+    if (conn->role == LlTx || conn->duplex) { // Wait until every queued frame is acknowledged
+        if (serviceWindow(conn, 0) == -1) {
+            printf("%s: An error occurred while draining the window.\n", __func__);
+            return -1;
+        }
+        stopRetransmissionTimer(conn);
+        conn->pollSent = FALSE;
+        stopTimer(&conn->pollTimer);
+        conn->timeoutCount = 0;
+    }
+    if (flushAck(conn) == -1) return -1; // The other end waits for it before it disconnects
+
+    if (showStatistics) {
+        printf("Statistics:\n");
+        printSession(conn);
+    }
+    if (conn->role == LlTx) { // Transmitter
+        while (conn->timeoutCount < conn->numberOfRetransmitions) {
             int bytesWritten = 0;
 
-            if (alarmEnabled == FALSE){
-                alarm(timeout); // Set alarm to be triggered after timeout
-                alarmEnabled = TRUE;
-
-                // Assemble DISC frame
-                int array_size = 5;
-                unsigned char BCC1 = ADDRESS_SENT_BY_TX ^ CONTROL_DISC;
-                unsigned char set_array[5] = {FLAG, ADDRESS_SENT_BY_TX, CONTROL_DISC, BCC1, FLAG};
-
-                // Send DISC frame
-                while (bytesWritten != 5) {
-                    bytesWritten = writeBytes((set_array + sizeof(unsigned char) * bytesWritten), array_size - bytesWritten);
-                    if (bytesWritten == -1) {
-                        printf("%s: An error occurred inside writeBytes.\n", __func__);
-                        return -1;
-                    }
-                }
-            }
+            // Assemble DISC frame
+            int array_size = 5;
+            unsigned char BCC1 = ADDRESS_SENT_BY_TX ^ CONTROL_DISC;
+            unsigned char set_array[5] = {FLAG, ADDRESS_SENT_BY_TX, CONTROL_DISC, BCC1, FLAG};
 
-            if (bytesWritten == 5) { 
-                alarm(0);
-                alarmEnabled = FALSE;
-                int csu = checkSUFrame(CONTROL_DISC, &alarmEnabled);
-                if (csu == -1) {
-                    printf("%s: An error occurred inside checkSUFrame.\n", __func__);
+            // Send DISC frame
+            while (bytesWritten != 5) {
+                bytesWritten = writeFrame(conn, (set_array + sizeof(unsigned char) * bytesWritten), array_size - bytesWritten);
+                if (bytesWritten == -1) {
+                    printf("%s: An error occurred inside writeFrame.\n", __func__);
                     return -1;
                 }
-                else break;   
             }
-            totalNumOfRetransmissions++;
+
+            // Wait for the DISC of rx
+            startTimer(&conn->timers, &conn->retransmissionTimer, conn->timeout * 1000.0 + untilLineFree(conn));
+            int csu = checkSUFrame(conn, CONTROL_DISC, &conn->retransmissionTimer);
+            if (csu == -1) {
+                printf("%s: An error occurred inside checkSUFrame.\n", __func__);
+                return -1;
+            }
+            else if (csu == 1) {
+                stopTimer(&conn->retransmissionTimer);
+                break;
+            }
+            countTimeout(conn);
+            conn->totalNumOfRetransmissions++;
         }
         if (showStatistics) { 
-            printf("Number of dropped packets (TX): %d\n", ((int)totalNumOfFrames) - ((int)(totalNumOfValidFrames)) - ((int)(totalNumOfInvalidFrames)));
-            printf("Total number of frames that were retransmitted: %ld\n", totalNumOfRetransmissions);
-            printf("Total number of timeouts: %ld\n", totalNumOfTimeouts);
+            printf("Number of dropped packets (TX): %d\n", ((int)conn->totalNumOfFrames) - ((int)(conn->totalNumOfValidFrames)) - ((int)(conn->totalNumOfInvalidFrames)));
+            printf("Total number of frames that were retransmitted: %ld\n", conn->totalNumOfRetransmissions);
+            printf("Total number of timeouts: %ld\n", conn->totalNumOfTimeouts);
+            if (conn->checkpoint) printf("Number of polls sent: %ld (%ld found only a response lost)\n", conn->totalNumOfPolls, conn->totalNumOfPollsWithoutLoss);
+            printf("Smoothed round trip time: %.1f ms (retransmission timeout %.1f ms)\n", conn->rtoEstimator.srtt, conn->rtoEstimator.rto);
+            printPayloadReport(&conn->payloadSizer);
         }
-    } else if (role == LlRx) { // Receiver
-        int enterCheckSUFrame = TRUE;
-        while (enterCheckSUFrame) {
-
-            int csu = checkSUFrame(CONTROL_DISC, &enterCheckSUFrame);
+    } else if (conn->role == LlRx) { // Receiver
+        while (TRUE) {
+            int csu = conn->discReceived ? 1 : checkSUFrame(conn, CONTROL_DISC, NULL);
+            conn->discReceived = FALSE;
             if (csu == -1) {
                 printf("%s: An error occurred inside checkSUFrame.\n", __func__);
                 return -1;
@@ -649,16 +2206,19 @@ int llclose(int showStatistics) {
             int BCC1 = ADDRESS_SENT_BY_TX ^ CONTROL_DISC;
             unsigned char ua_array[5] = {FLAG, ADDRESS_SENT_BY_TX, CONTROL_DISC, BCC1, FLAG};
 
-            int wb = writeBytes(ua_array, 5);
+            int wb = writeFrame(conn, ua_array, 5);
 
             if (wb == -1) {
-                printf("%s: An error occurred inside writeBytes.\n", __func__);
+                printf("%s: An error occurred inside writeFrame.\n", __func__);
                 return -1;
             }
             else if (wb == 5) {
                 if (showStatistics){
-                    printf("Number of dropped packets (RX): %d\n", ((int)totalNumOfFrames) - ((int)(totalNumOfValidFrames)) - ((int)(totalNumOfInvalidFrames)) - ((int)(totalNumOfDuplicateFrames)));
-                    printf("Number of frames received that were duplicate: %ld\n", totalNumOfDuplicateFrames);
+                    printf("Number of dropped packets (RX): %d\n", ((int)conn->totalNumOfFrames) - ((int)(conn->totalNumOfValidFrames)) - ((int)(conn->totalNumOfInvalidFrames)) - ((int)(conn->totalNumOfDuplicateFrames)) - ((int)(conn->totalNumOfOutOfSequenceFrames)));
+                    printf("Number of frames received that were duplicate: %ld\n", conn->totalNumOfDuplicateFrames);
+                    printf("Number of frames received out of sequence: %ld\n", conn->totalNumOfOutOfSequenceFrames);
+                    printf("Number of acknowledgements sent: %ld (%d frames per RR at most)\n", conn->totalNumOfAcks, conn->ackEvery);
+                    if (conn->fecParity > 0) printf("Number of frames corrected by FEC: %ld (%ld bytes)\n", conn->totalNumOfCorrectedFrames, conn->totalNumOfCorrectedBytes);
                 }
                 break;
             }
@@ -667,14 +2227,140 @@ int llclose(int showStatistics) {
     }    
    
     if (showStatistics){
-        printf("Number of frames that were sent/received and are valid: %ld\n", totalNumOfValidFrames);
-        printf("Number of frames that were sent/received and are invalid: %ld\n", totalNumOfInvalidFrames);
-        printf("Total number of frames that were sent/received: %ld\n", totalNumOfFrames);
+        printf("Number of frames that were sent/received and are valid: %ld\n", conn->totalNumOfValidFrames);
+        printf("Number of frames that were sent/received and are invalid: %ld\n", conn->totalNumOfInvalidFrames);
+        printf("Total number of frames that were sent/received: %ld\n", conn->totalNumOfFrames);
     }
+    return 1;
+}
+
 
-    if (closeSerialPort() == -1){
+////////////////////////////////////////////////
+// CONNECTIONS
+////////////////////////////////////////////////
+/**
+ * Frees a connection and everything it holds (frames left in the window, parser, timers, event fd, io_uring and serial port)
+ * Requests still queued are dropped without their callbacks.
+ * returns 0 on success
+ *        -1 if the serial port could not be closed
+*/
+int freeConnection(LinkConnection* conn) {
+    for (int seq = 0; seq < MAX_MODULUS; seq++) free(conn->txWindow[seq].storage);
+    freeFrameParser(&conn->parser);
+    closeTimers(&conn->timers);
+    if (conn->epollFd != -1) close(conn->epollFd);
+
+    int result = 0;
+    if (conn->ioRing != NULL) { // Sends what is still staged first
+        if (closeIoRing(conn->ioRing) == -1) {
+            printf("%s: Error while closing the io_uring\n", __func__);
+            result = -1;
+        }
+        free(conn->ioRing);
+    }
+    if (conn->port.fd != -1 && closePort(&conn->port) == -1) {
         printf("%s: Error while closing serial port\n", __func__);
-        return -1;
+        result = -1;
     }
-    return 1;
+    free(conn);
+    return result;
+}
+
+LinkConnection* ll_open(LinkLayer connectionParameters) {
+    LinkConnection* conn = (LinkConnection*)calloc(1, sizeof(LinkConnection));
+    if (conn == NULL) {
+        printf("%s: An error occurred in calloc.\n", __func__);
+        return NULL;
+    }
+    conn->port.fd = -1;
+    conn->timers.timerFd = -1;
+    conn->epollFd = -1;
+    conn->modulus = 2;
+    conn->windowSize = 1;
+    conn->maxPayloadSize = MAX_PAYLOAD_SIZE;
+    conn->ackEvery = 1;
+
+    if (openConnection(conn, connectionParameters) == -1) {
+        freeConnection(conn);
+        return NULL;
+    }
+    return conn;
+}
+
+int ll_close(LinkConnection* conn, int showStatistics) {
+    if (conn == NULL) return -1;
+    int result = closeConnection(conn, showStatistics);
+    if (freeConnection(conn) == -1) return -1;
+    return result;
+}
+
+
+////////////////////////////////////////////////
+// ORIGINAL INTERFACE
+////////////////////////////////////////////////
+int llopen(LinkLayer connectionParameters) {
+    if (defaultConnection != NULL) ll_close(defaultConnection, FALSE);
+    defaultConnection = ll_open(connectionParameters);
+    return defaultConnection == NULL ? -1 : 1;
+}
+
+int llwrite(const unsigned char *buf, int bufSize) {
+    if (defaultConnection == NULL) return -1;
+    return ll_write(defaultConnection, buf, bufSize);
+}
+
+int llwritev(const struct iovec *iov, int iovcnt) {
+    if (defaultConnection == NULL) return -1;
+    return ll_writev(defaultConnection, iov, iovcnt);
+}
+
+int llwriteBatch(const struct iovec *iov, const int iovcnt[], int numPackets) {
+    if (defaultConnection == NULL) return -1;
+    return ll_writeBatch(defaultConnection, iov, iovcnt, numPackets);
+}
+
+int llencodedSize() {
+    if (defaultConnection == NULL) return -1;
+    return ll_encodedSize(defaultConnection);
+}
+
+int llencode(const struct iovec *iov, int iovcnt, unsigned char *frame) {
+    if (defaultConnection == NULL) return -1;
+    return ll_encode(defaultConnection, iov, iovcnt, frame);
+}
+
+int llwriteEncoded(unsigned char *frame, int frameSize, int dataSize) {
+    if (defaultConnection == NULL) return -1;
+    return ll_writeEncoded(defaultConnection, frame, frameSize, dataSize);
+}
+
+int llread(unsigned char *packet) {
+    if (defaultConnection == NULL) return -1;
+    return ll_read(defaultConnection, packet);
+}
+
+int llreadBatch(unsigned char *packets[], int sizes[], int maxPackets) {
+    if (defaultConnection == NULL) return -1;
+    return ll_readBatch(defaultConnection, packets, sizes, maxPackets);
+}
+
+int llpayloadSize() {
+    if (defaultConnection == NULL) return -1;
+    return ll_payloadSize(defaultConnection);
+}
+
+int llunacknowledged() {
+    if (defaultConnection == NULL) return -1;
+    return ll_unacknowledged(defaultConnection);
+}
+
+int llreadAvailable() {
+    if (defaultConnection == NULL) return -1;
+    return ll_readAvailable(defaultConnection);
+}
+
+int llclose(int showStatistics) {
+    int result = ll_close(defaultConnection, showStatistics);
+    defaultConnection = NULL;
+    return result;
 }
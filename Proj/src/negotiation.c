@@ -0,0 +1,126 @@
+// Link parameter negotiation implementation
+// Options are ordered from worst to best (higher ARQ mode and FCS type values are better),
+// option 0 is the original protocol and every peer accepts it.
+#include "negotiation.h"
+
+void legacyParameters(LinkParameters *params) {
+    params->arqMode = 0;
+    params->arqModes = 1;
+    params->windowSize = 1;
+    params->maxPayload = 1000;
+    params->fcsType = FCS_BCC2;
+    params->fcsTypes = 1 << FCS_BCC2;
+    params->fecParity = 0;
+    params->duplex = 0;
+    params->checkpoint = 0;
+}
+
+/**
+ * Appends a parameter to buf
+ * returns number of bytes written
+*/
+static int putParameter(unsigned char *buf, unsigned char type, int length, int value) {
+    buf[0] = type;
+    buf[1] = length;
+    for (int i = 0; i < length; i++) buf[2 + i] = (value >> (8 * (length - 1 - i))) & 0xFF;
+    return 2 + length;
+}
+
+int encodeParameters(const LinkParameters *params, unsigned char *buf) {
+    int size = 0;
+    size += putParameter(buf + size, PARAM_ARQ, 2, (params->arqMode << 8) | params->arqModes);
+    size += putParameter(buf + size, PARAM_WINDOW, 1, params->windowSize);
+    size += putParameter(buf + size, PARAM_MAX_PAYLOAD, 2, params->maxPayload);
+    size += putParameter(buf + size, PARAM_FCS, 2, (params->fcsType << 8) | params->fcsTypes);
+    size += putParameter(buf + size, PARAM_FEC, 1, params->fecParity);
+    size += putParameter(buf + size, PARAM_DUPLEX, 1, params->duplex);
+    size += putParameter(buf + size, PARAM_CHECKPOINT, 1, params->checkpoint);
+    return size;
+}
+
+int decodeParameters(const unsigned char *buf, int size, LinkParameters *params) {
+    legacyParameters(params);
+
+    int offset = 0;
+    while (offset < size) {
+        if (offset + 2 > size || offset + 2 + buf[offset + 1] > size) return -1;
+        unsigned char type = buf[offset];
+        int length = buf[offset + 1];
+        const unsigned char *value = buf + offset + 2;
+        offset += 2 + length;
+
+        switch (type) {
+            case PARAM_ARQ:
+                if (length != 2) return -1;
+                params->arqMode = value[0];
+                params->arqModes = value[1] | 1;
+                break;
+            case PARAM_WINDOW:
+                if (length != 1 || value[0] == 0) return -1;
+                params->windowSize = value[0];
+                break;
+            case PARAM_MAX_PAYLOAD:
+                if (length != 2) return -1;
+                params->maxPayload = (value[0] << 8) | value[1];
+                break;
+            case PARAM_FCS:
+                if (length != 2) return -1;
+                params->fcsType = (FcsType)value[0];
+                params->fcsTypes = value[1] | (1 << FCS_BCC2);
+                break;
+            case PARAM_FEC:
+                if (length != 1) return -1;
+                params->fecParity = value[0];
+                break;
+            case PARAM_DUPLEX:
+                if (length != 1) return -1;
+                params->duplex = value[0] != 0;
+                break;
+            case PARAM_CHECKPOINT:
+                if (length != 1) return -1;
+                params->checkpoint = value[0] != 0;
+                break;
+            default: // Parameter of a newer peer
+                break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Preferred option if it is accepted, the best accepted one otherwise
+*/
+static int chooseOption(int preferred, int accepted) {
+    if (preferred >= 0 && preferred < 8 && (accepted & (1 << preferred))) return preferred;
+    int best = 0;
+    for (int option = 0; option < 8; option++) {
+        if (accepted & (1 << option)) best = option;
+    }
+    return best;
+}
+
+static int minimum(int a, int b) {
+    return a < b ? a : b;
+}
+
+void negotiateParameters(const LinkParameters *offer, const LinkParameters *local, LinkParameters *session) {
+    session->arqMode = chooseOption(offer->arqMode, offer->arqModes & local->arqModes);
+    session->arqModes = 1 << session->arqMode;
+    session->windowSize = minimum(offer->windowSize, local->windowSize);
+    session->maxPayload = minimum(offer->maxPayload, local->maxPayload);
+    session->fcsType = (FcsType)chooseOption(offer->fcsType, offer->fcsTypes & local->fcsTypes);
+    session->fcsTypes = 1 << session->fcsType;
+    session->fecParity = minimum(offer->fecParity, local->fecParity);
+    session->duplex = offer->duplex && local->duplex && session->arqMode != 0;
+    session->checkpoint = offer->checkpoint && local->checkpoint;
+}
+
+int acceptSession(const LinkParameters *offer, const LinkParameters *session) {
+    if (session->arqMode < 0 || session->arqMode >= 8 || !(offer->arqModes & (1 << session->arqMode))) return 0;
+    if ((int)session->fcsType < 0 || session->fcsType >= 8 || !(offer->fcsTypes & (1 << session->fcsType))) return 0;
+    if (session->windowSize < 1 || session->windowSize > offer->windowSize) return 0;
+    if (session->maxPayload < 1 || session->maxPayload > offer->maxPayload) return 0;
+    if (session->duplex && (!offer->duplex || session->arqMode == 0)) return 0;
+    if (session->checkpoint && !offer->checkpoint) return 0;
+    return session->fecParity >= 0 && session->fecParity <= offer->fecParity;
+}
@@ -0,0 +1,93 @@
+// Adaptive payload size implementation
+// Errors and bits are both multiplied by 1 - frame bits / PAYLOAD_WINDOW_BITS for every frame,
+// so the estimate follows the last few hundred kilobits whatever the frame size is.
+// The Makefile does not link libm, so the square root is computed here and -ln(1 - p) is
+// taken as p (the error rates that matter are far below 1%, above it the smallest size wins anyway).
+#include "payload_size.h"
+
+#include <stdio.h>
+
+#define PAYLOAD_WINDOW_BITS 400000.0 // About 50 frames of 1000 bytes
+
+/**
+ * Square root (Newton's method, x > 0)
+*/
+static double squareRoot(double x) {
+    double root = x > 1 ? x : 1;
+    for (int i = 0; i < 64; i++) {
+        double next = (root + x / root) / 2;
+        if (next >= root) break;
+        root = next;
+    }
+    return root;
+}
+
+/**
+ * Payload size with the best expected goodput for the current error estimate
+*/
+static int bestPayloadSize(const PayloadSizer *sizer) {
+    if (sizer->errors <= 0 || sizer->bits <= 0) return sizer->maxSize;
+
+    double ber = sizer->errors / sizer->bits;
+    double a = 8 * ber;
+    double h = sizer->overhead + sizer->idle;
+    double size = (squareRoot(h * h + 4 * h / a) - h) / 2;
+
+    if (size < sizer->minSize) return sizer->minSize;
+    if (size > sizer->maxSize) return sizer->maxSize;
+    return (int)size;
+}
+
+void initPayloadSizer(PayloadSizer *sizer, int minSize, int maxSize, int overhead) {
+    sizer->errors = 0;
+    sizer->bits = 0;
+    sizer->overhead = overhead;
+    sizer->idle = 0;
+    sizer->minSize = minSize;
+    sizer->maxSize = maxSize;
+    sizer->size = maxSize;
+    for (int i = 0; i < PAYLOAD_REPORT_BUCKETS; i++) sizer->sent[i] = 0;
+    sizer->numFrames = 0;
+    sizer->totalBytes = 0;
+    sizer->smallest = maxSize;
+    sizer->largest = 0;
+}
+
+void payloadSample(PayloadSizer *sizer, int frameSize, int errored) {
+    double bits = 8.0 * frameSize;
+    double decay = bits < PAYLOAD_WINDOW_BITS ? 1 - bits / PAYLOAD_WINDOW_BITS : 0;
+    sizer->errors = sizer->errors * decay + (errored ? 1 : 0);
+    sizer->bits = sizer->bits * decay + bits;
+    sizer->size = bestPayloadSize(sizer);
+}
+
+void payloadIdleSample(PayloadSizer *sizer, double idleBytes) {
+    if (idleBytes < 0) idleBytes = 0;
+    sizer->idle += (idleBytes - sizer->idle) / 8;
+    sizer->size = bestPayloadSize(sizer);
+}
+
+void recordPayloadSize(PayloadSizer *sizer, int size) {
+    int bucketSize = (sizer->maxSize + PAYLOAD_REPORT_BUCKETS - 1) / PAYLOAD_REPORT_BUCKETS;
+    int bucket = size > 0 ? (size - 1) / bucketSize : 0;
+    if (bucket >= PAYLOAD_REPORT_BUCKETS) bucket = PAYLOAD_REPORT_BUCKETS - 1;
+
+    sizer->sent[bucket]++;
+    sizer->numFrames++;
+    sizer->totalBytes += size;
+    if (size < sizer->smallest) sizer->smallest = size;
+    if (size > sizer->largest) sizer->largest = size;
+}
+
+void printPayloadReport(const PayloadSizer *sizer) {
+    if (sizer->numFrames == 0) return;
+    int bucketSize = (sizer->maxSize + PAYLOAD_REPORT_BUCKETS - 1) / PAYLOAD_REPORT_BUCKETS;
+
+    printf("Payload sizes sent: %d to %d bytes, %.1f on average (estimated BER %.2g)\n",
+           sizer->smallest, sizer->largest, (double)sizer->totalBytes / sizer->numFrames,
+           sizer->bits > 0 ? sizer->errors / sizer->bits : 0);
+    for (int i = 0; i < PAYLOAD_REPORT_BUCKETS; i++) {
+        if (sizer->sent[i] == 0) continue;
+        printf("  %4d - %4d bytes: %lu frames\n", i * bucketSize + 1, (i + 1) * bucketSize, sizer->sent[i]);
+    }
+}
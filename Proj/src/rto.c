@@ -0,0 +1,44 @@
+// Retransmission timeout estimator implementation
+// Same gains as TCP (RFC 6298): alpha = 1/8 for the round trip time, beta = 1/4 for its variation.
+#include "rto.h"
+
+#define RTO_ALPHA 0.125
+#define RTO_BETA 0.25
+#define RTO_K 4
+
+/**
+ * Keeps the timeout between the minimum and the maximum
+*/
+static void clampRto(RtoEstimator *estimator) {
+    if (estimator->rto < estimator->minRto) estimator->rto = estimator->minRto;
+    if (estimator->rto > estimator->maxRto) estimator->rto = estimator->maxRto;
+}
+
+void initRtoEstimator(RtoEstimator *estimator, double minRto, double maxRto) {
+    estimator->srtt = 0;
+    estimator->rttvar = 0;
+    estimator->minRto = minRto;
+    estimator->maxRto = maxRto;
+    estimator->rto = maxRto;
+    estimator->numSamples = 0;
+}
+
+void rtoSample(RtoEstimator *estimator, double rtt) {
+    if (estimator->numSamples == 0) {
+        estimator->srtt = rtt;
+        estimator->rttvar = rtt / 2;
+    } else {
+        double error = estimator->srtt - rtt;
+        if (error < 0) error = -error;
+        estimator->rttvar = (1 - RTO_BETA) * estimator->rttvar + RTO_BETA * error;
+        estimator->srtt = (1 - RTO_ALPHA) * estimator->srtt + RTO_ALPHA * rtt;
+    }
+    estimator->numSamples++;
+    estimator->rto = estimator->srtt + RTO_K * estimator->rttvar;
+    clampRto(estimator);
+}
+
+void rtoBackoff(RtoEstimator *estimator) {
+    estimator->rto *= 2;
+    clampRto(estimator);
+}
@@ -0,0 +1,87 @@
+// Buffered serial port reader implementation
+// The ring buffer is indexed with free running counters: head is the next byte to be
+// returned, tail is where the next read() stores bytes, tail - head bytes are buffered.
+#include "serial_buffer.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Reads as many bytes as are available (and fit) into the ring buffer
+ * timeoutMs - maximum time to wait for the first byte
+ * returns number of bytes read
+ *        -1 on error
+*/
+static int fillReadBuffer(ReadBuffer *buffer, int timeoutMs) {
+    // Empty, so the whole buffer is contiguous again (unless the ring is reading into it)
+    if (buffer->head == buffer->tail && (buffer->ioRing == NULL || !ioRingReading(buffer->ioRing))) buffer->head = buffer->tail = 0;
+
+    unsigned int used = buffer->tail - buffer->head;
+    if (used == READ_BUFFER_SIZE) return 0;
+
+    unsigned int start = buffer->tail % READ_BUFFER_SIZE;
+    unsigned int space = READ_BUFFER_SIZE - used;
+    if (space > READ_BUFFER_SIZE - start) space = READ_BUFFER_SIZE - start;
+
+    if (buffer->ioRing != NULL) { // The read in flight started at tail too
+        int n = ioRingRead(buffer->ioRing, buffer->ring + start, space, timeoutMs);
+        if (n > 0) buffer->tail += n;
+        return n;
+    }
+
+    if (timeoutMs != 0) {
+        struct pollfd pfd = {.fd = buffer->fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, timeoutMs);
+        if (ready == -1) return errno == EINTR ? 0 : -1; // Interrupted by a signal
+        if (ready == 0) return 0;
+    }
+
+    int n = read(buffer->fd, buffer->ring + start, space);
+    if (n == -1) return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+    buffer->tail += n;
+    return n;
+}
+
+int peekBytes(ReadBuffer *buffer, const unsigned char **bytes, int timeoutMs) {
+    if (buffer->head == buffer->tail && fillReadBuffer(buffer, timeoutMs) == -1) return -1;
+
+    unsigned int start = buffer->head % READ_BUFFER_SIZE;
+    unsigned int available = buffer->tail - buffer->head;
+    if (available > READ_BUFFER_SIZE - start) available = READ_BUFFER_SIZE - start;
+
+    *bytes = buffer->ring + start;
+    return available;
+}
+
+void consumeBytes(ReadBuffer *buffer, int numBytes) {
+    buffer->head += numBytes;
+}
+
+int readBytes(ReadBuffer *buffer, unsigned char *buf, int maxBytes, int timeoutMs) {
+    int copied = 0;
+
+    // Only the first chunk may wait or read from the port, the rest comes from the buffer (wrap around)
+    while (copied < maxBytes && (copied == 0 || buffer->head != buffer->tail)) {
+        const unsigned char *bytes;
+        int available = peekBytes(buffer, &bytes, timeoutMs);
+        if (available == -1) return -1;
+        if (available == 0) break;
+
+        if (available > maxBytes - copied) available = maxBytes - copied;
+        memcpy(buf + copied, bytes, available);
+        consumeBytes(buffer, available);
+        copied += available;
+    }
+    return copied;
+}
+
+void resetReadBuffer(ReadBuffer *buffer, int fd) {
+    buffer->fd = fd;
+    buffer->head = buffer->tail = 0;
+}
+
+void readThroughRing(ReadBuffer *buffer, IoRing *ring) {
+    buffer->ioRing = ring;
+}
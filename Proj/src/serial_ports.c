@@ -0,0 +1,43 @@
+// Serial ports implementation
+// serial_port.c keeps its port in the globals fd and oldtio. A port is opened and closed by
+// openSerialPort and closeSerialPort with the globals holding that port, one at a time, and
+// its descriptor and settings are then kept in the SerialPort.
+
+#include "serial_ports.h"
+#include "serial_port.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+extern int fd;              // Port of serial_port.c
+extern struct termios oldtio;
+
+static pthread_mutex_t portLock = PTHREAD_MUTEX_INITIALIZER; // Links may be opened from several threads
+
+int openPort(SerialPort *port, const char *serialPort, int baudRate)
+{
+    pthread_mutex_lock(&portLock);
+    port->fd = openSerialPort(serialPort, baudRate);
+    port->oldtio = oldtio;
+    fd = -1; // The port belongs to its SerialPort now
+    pthread_mutex_unlock(&portLock);
+    return port->fd;
+}
+
+int closePort(SerialPort *port)
+{
+    pthread_mutex_lock(&portLock);
+    fd = port->fd;
+    oldtio = port->oldtio;
+    int result = closeSerialPort();
+    fd = -1;
+    pthread_mutex_unlock(&portLock);
+    port->fd = -1;
+    return result;
+}
+
+int writePort(SerialPort *port, const char *bytes, int numBytes)
+{
+    // writeBytes on the port's descriptor, without the lock (a write never blocks another port)
+    return write(port->fd, bytes, numBytes);
+}
@@ -0,0 +1,115 @@
+// Single-producer single-consumer ring implementation
+// Each counter has a single writer: tail is only stored by the producer, head and taken by the consumer.
+// A side about to sleep sets its waiting flag and then checks the counter again, the other side
+// moves the counter and then clears the flag, posting if it was set. Both use sequentially
+// consistent operations, so at least one of them sees the other and no wakeup is lost
+// (a post that was not needed only makes the next wait check the counter once more).
+#include "spsc_ring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#define SLOT_ALIGNMENT 16
+
+/**
+ * Sleeps until the other side posts (or the ring is aborted), unless ready already holds
+ * waiting - flag of this side
+ * ready - checks the counters again once the flag is set
+*/
+static void sleepUnless(SpscRing *ring, int *waiting, sem_t *wake, int (*ready)(SpscRing *)) {
+    __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+    if (!ready(ring) && !__atomic_load_n(&ring->aborted, __ATOMIC_SEQ_CST)) {
+        while (sem_wait(wake) == -1 && errno == EINTR);
+    }
+    __atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Wakes the other side if it sleeps
+*/
+static void wakeUp(int *waiting, sem_t *wake) {
+    if (__atomic_exchange_n(waiting, 0, __ATOMIC_SEQ_CST)) sem_post(wake);
+}
+
+static int hasFreeSlot(SpscRing *ring) {
+    return ring->tail - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) < ring->numSlots &&
+           ring->tail - __atomic_load_n(&ring->taken, __ATOMIC_SEQ_CST) < ring->maxAhead;
+}
+
+static int hasPublishedSlot(SpscRing *ring) {
+    return __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) != ring->taken;
+}
+
+int initSpscRing(SpscRing *ring, int numSlots, int slotSize) {
+    if (numSlots < 1 || slotSize < 1) return -1;
+    ring->slotSize = (slotSize + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+    ring->numSlots = numSlots;
+    ring->slots = (unsigned char *)aligned_alloc(SLOT_ALIGNMENT, (size_t)numSlots * ring->slotSize);
+    if (ring->slots == NULL) return -1;
+
+    ring->head = ring->taken = ring->tail = 0;
+    ring->maxAhead = numSlots;
+    ring->aborted = 0;
+    ring->producerWaiting = ring->consumerWaiting = 0;
+    if (sem_init(&ring->producerWake, 0, 0) == -1 || sem_init(&ring->consumerWake, 0, 0) == -1) {
+        free(ring->slots);
+        return -1;
+    }
+    return 0;
+}
+
+void freeSpscRing(SpscRing *ring) {
+    sem_destroy(&ring->producerWake);
+    sem_destroy(&ring->consumerWake);
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+void spscLimitAhead(SpscRing *ring, unsigned int maxAhead) {
+    ring->maxAhead = maxAhead < 1 ? 1 : maxAhead;
+}
+
+void *spscReserve(SpscRing *ring) {
+    while (!hasFreeSlot(ring)) {
+        if (__atomic_load_n(&ring->aborted, __ATOMIC_SEQ_CST)) return NULL;
+        sleepUnless(ring, &ring->producerWaiting, &ring->producerWake, hasFreeSlot);
+    }
+    if (__atomic_load_n(&ring->aborted, __ATOMIC_SEQ_CST)) return NULL;
+    return ring->slots + (size_t)(ring->tail % ring->numSlots) * ring->slotSize;
+}
+
+void spscPublish(SpscRing *ring) {
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_SEQ_CST);
+    wakeUp(&ring->consumerWaiting, &ring->consumerWake);
+}
+
+void *spscPeek(SpscRing *ring) {
+    while (!hasPublishedSlot(ring)) {
+        if (__atomic_load_n(&ring->aborted, __ATOMIC_SEQ_CST)) return NULL;
+        sleepUnless(ring, &ring->consumerWaiting, &ring->consumerWake, hasPublishedSlot);
+    }
+    if (__atomic_load_n(&ring->aborted, __ATOMIC_SEQ_CST)) return NULL;
+    return ring->slots + (size_t)(ring->taken % ring->numSlots) * ring->slotSize;
+}
+
+void *spscPeekAhead(SpscRing *ring, unsigned int n) {
+    if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) - ring->taken <= n) return NULL;
+    return ring->slots + (size_t)((ring->taken + n) % ring->numSlots) * ring->slotSize;
+}
+
+void spscTake(SpscRing *ring) {
+    __atomic_store_n(&ring->taken, ring->taken + 1, __ATOMIC_SEQ_CST);
+    wakeUp(&ring->producerWaiting, &ring->producerWake);
+}
+
+void spscRelease(SpscRing *ring) {
+    if (ring->taken == ring->head) __atomic_store_n(&ring->taken, ring->taken + 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_SEQ_CST);
+    wakeUp(&ring->producerWaiting, &ring->producerWake);
+}
+
+void spscAbort(SpscRing *ring) {
+    __atomic_store_n(&ring->aborted, 1, __ATOMIC_SEQ_CST);
+    sem_post(&ring->producerWake);
+    sem_post(&ring->consumerWake);
+}
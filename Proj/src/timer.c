@@ -0,0 +1,104 @@
+// Timers implementation
+// Running timers are kept in a list, the timerfd is armed (absolute time) for the earliest
+// deadline right before poll(). A deadline that already passed makes the timerfd readable at once.
+#include "timer.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+int openTimers(TimerSet *set) {
+    set->runningTimers = NULL;
+    set->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    return set->timerFd == -1 ? -1 : 0;
+}
+
+void closeTimers(TimerSet *set) {
+    while (set->runningTimers != NULL) stopTimer(set->runningTimers);
+    if (set->timerFd != -1) close(set->timerFd);
+    set->timerFd = -1;
+}
+
+void startTimer(TimerSet *set, Timer *timer, double ms) {
+    long ns = (long)(ms * 1e6);
+    clock_gettime(CLOCK_MONOTONIC, &timer->deadline);
+    timer->deadline.tv_sec += ns / 1000000000L;
+    timer->deadline.tv_nsec += ns % 1000000000L;
+    if (timer->deadline.tv_nsec >= 1000000000L) {
+        timer->deadline.tv_sec++;
+        timer->deadline.tv_nsec -= 1000000000L;
+    }
+
+    if (timer->running) return;
+    timer->running = 1;
+    timer->set = set;
+    timer->next = set->runningTimers;
+    set->runningTimers = timer;
+}
+
+void stopTimer(Timer *timer) {
+    if (!timer->running) return;
+    for (Timer **t = &timer->set->runningTimers; *t != NULL; t = &(*t)->next) {
+        if (*t == timer) {
+            *t = timer->next;
+            break;
+        }
+    }
+    timer->running = 0;
+    timer->next = NULL;
+    timer->set = NULL;
+}
+
+/**
+ * returns 1 if deadline a is before deadline b
+*/
+static int before(const struct timespec *a, const struct timespec *b) {
+    if (a->tv_sec != b->tv_sec) return a->tv_sec < b->tv_sec;
+    return a->tv_nsec < b->tv_nsec;
+}
+
+int timerExpired(const Timer *timer) {
+    if (!timer->running) return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return !before(&now, &timer->deadline);
+}
+
+int armTimers(TimerSet *set) {
+    // Armed for the earliest deadline (disarmed when no timer is running)
+    struct itimerspec value = {{0, 0}, {0, 0}};
+    for (Timer *t = set->runningTimers; t != NULL; t = t->next) {
+        if (t == set->runningTimers || before(&t->deadline, &value.it_value)) value.it_value = t->deadline;
+    }
+    if (set->runningTimers != NULL && value.it_value.tv_sec == 0 && value.it_value.tv_nsec == 0) value.it_value.tv_nsec = 1; // 0 would disarm it
+    return timerfd_settime(set->timerFd, TFD_TIMER_ABSTIME, &value, NULL);
+}
+
+int clearTimers(TimerSet *set) {
+    unsigned long long expirations;
+    if (read(set->timerFd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) return -1;
+    return 0;
+}
+
+int msUntilNextTimer(const TimerSet *set) {
+    if (set->runningTimers == NULL) return -1;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long earliest = -1;
+    for (Timer *t = set->runningTimers; t != NULL; t = t->next) {
+        long long ns = (t->deadline.tv_sec - now.tv_sec) * 1000000000LL + (t->deadline.tv_nsec - now.tv_nsec);
+        if (earliest == -1 || ns < earliest) earliest = ns > 0 ? ns : 0;
+    }
+    return (int)((earliest + 999999) / 1000000);
+}
+
+int waitForEvents(TimerSet *set, int fd) {
+    if (armTimers(set) == -1) return -1;
+
+    struct pollfd fds[2] = {{.fd = fd, .events = POLLIN}, {.fd = set->timerFd, .events = POLLIN}};
+    if (poll(fds, 2, -1) == -1) return errno == EINTR ? 0 : -1;
+
+    if ((fds[1].revents & POLLIN) && clearTimers(set) == -1) return -1; // Clear the expiration count
+    return 0;
+}
@@ -0,0 +1,246 @@
+// Asynchronous interface test and benchmark.
+// A single thread drives both ends of a link from one epoll loop: it keeps writes and reads
+// queued with ll_submitWrite / ll_submitRead, waits on the event fd of each connection and calls
+// ll_poll on the ones that are ready. The link is a pair of pseudo terminals joined by the relay
+// of Tests/pty_relay.c, which paces each direction at the baud rate (and can flip bits). Built
+// with DUPLEX both ends send and receive at once. The time the loop thread spent running is
+// reported too: the rest of the transfer it was free for other work.
+// Build (from the repository root, with a CRC so bit errors cannot get through):
+//   gcc -O2 -W -pthread -DARQ_MODE=2 -DFCS_TYPE=FCS_CRC32C -o async Tests/async.c Tests/pty_relay.c Proj/src/*.c -IProj/include
+// Run:
+//   ./async [size] [ber]
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+
+#include "link_layer.h"
+#include "link_layer_ext.h"
+#include "pty_relay.h"
+
+#define BAUD_RATE 115200
+#define QUEUE_DEPTH 4  // Requests kept queued in each direction
+
+#ifndef DUPLEX
+#define DUPLEX 0
+#endif
+
+typedef struct {
+    char port[50];
+    LinkLayerRole role;
+    LinkConnection* conn;
+    int sends;    // Sends size bytes
+    int receives; // Receives the size bytes of the other end
+    int submitted, written, received; // Bytes
+    int writesSubmitted, writesQueued, readsSubmitted, readsDone;
+    unsigned char writeBuffers[QUEUE_DEPTH][MAX_PAYLOAD_SIZE];
+    unsigned char readBuffers[QUEUE_DEPTH][MAX_PAYLOAD_SIZE];
+    int failed;
+} Endpoint;
+
+static double ber = 0;
+static int size = 100000;
+static volatile int relaying = 1;
+
+/**
+ * Seconds the calling thread ran
+*/
+double threadTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Stream of the bytes sent by an end
+*/
+int stream(LinkLayerRole role) {
+    return role == LlTx ? 0 : 1;
+}
+
+/**
+ * Relays both directions of the link until relaying is cleared
+*/
+void* runRelay(void* arg) {
+    RelayedLink* link = (RelayedLink*)arg;
+    double last = now();
+    while (relaying) {
+        usleep(1000);
+        double t = now();
+        relayLink(link, t - last);
+        last = t;
+    }
+    return NULL;
+}
+
+/**
+ * Opens the connection of an endpoint (the handshake blocks, so both ends open at once)
+*/
+void* openEndpoint(void* arg) {
+    Endpoint* endpoint = (Endpoint*)arg;
+    LinkLayer parameters;
+    strcpy(parameters.serialPort, endpoint->port);
+    parameters.role = endpoint->role;
+    parameters.baudRate = BAUD_RATE;
+    parameters.nRetransmissions = 5;
+    parameters.timeout = 2;
+    endpoint->conn = ll_open(parameters);
+    return NULL;
+}
+
+/**
+ * Closes the connection of an endpoint (tx drains its window first)
+*/
+void* closeEndpoint(void* arg) {
+    Endpoint* endpoint = (Endpoint*)arg;
+    if (ll_close(endpoint->conn, FALSE) != 1) endpoint->failed = 1;
+    return NULL;
+}
+
+/**
+ * Runs a function for both endpoints at once
+*/
+void bothEndpoints(void* (*function)(void*), Endpoint* endpoints) {
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++) pthread_create(&threads[i], NULL, function, &endpoints[i]);
+    for (int i = 0; i < 2; i++) pthread_join(threads[i], NULL);
+}
+
+void onWritten(LinkConnection* conn, int result, void* arg) {
+    (void)conn;
+    Endpoint* endpoint = (Endpoint*)arg;
+    endpoint->writesQueued--;
+    if (result < 0) endpoint->failed = 1;
+    else endpoint->written += result;
+}
+
+void onRead(LinkConnection* conn, int result, void* arg) {
+    (void)conn;
+    Endpoint* endpoint = (Endpoint*)arg;
+    unsigned char* packet = endpoint->readBuffers[endpoint->readsDone++ % QUEUE_DEPTH];
+    if (result < 0 || endpoint->received + result > size) {
+        endpoint->failed = 1;
+        return;
+    }
+    int sender = stream(endpoint->role == LlTx ? LlRx : LlTx);
+    for (int i = 0; i < result; i++) {
+        if (packet[i] != pattern(sender, endpoint->received + i)) {
+            printf("%s: byte %d differs\n", endpoint->role == LlTx ? "tx" : "rx", endpoint->received + i);
+            endpoint->failed = 1;
+            return;
+        }
+    }
+    endpoint->received += result;
+}
+
+/**
+ * Keeps QUEUE_DEPTH writes and reads queued until the endpoint sent and received everything
+ * returns 0 on success
+ *        -1 if a request could not be submitted
+*/
+int submitRequests(Endpoint* endpoint) {
+    while (endpoint->sends && endpoint->writesQueued < QUEUE_DEPTH && endpoint->submitted < size) {
+        int n = ll_payloadSize(endpoint->conn);
+        if (n > size - endpoint->submitted) n = size - endpoint->submitted;
+        unsigned char* buf = endpoint->writeBuffers[endpoint->writesSubmitted % QUEUE_DEPTH];
+        for (int i = 0; i < n; i++) buf[i] = pattern(stream(endpoint->role), endpoint->submitted + i);
+        if (ll_submitWrite(endpoint->conn, buf, n, onWritten, endpoint) == -1) return -1;
+        endpoint->submitted += n;
+        endpoint->writesSubmitted++;
+        endpoint->writesQueued++;
+    }
+    while (endpoint->receives && endpoint->received < size && endpoint->readsSubmitted - endpoint->readsDone < QUEUE_DEPTH) {
+        unsigned char* packet = endpoint->readBuffers[endpoint->readsSubmitted % QUEUE_DEPTH];
+        if (ll_submitRead(endpoint->conn, packet, onRead, endpoint) == -1) return -1;
+        endpoint->readsSubmitted++;
+    }
+    return 0;
+}
+
+/**
+ * Returns 1 once the endpoint sent and received everything it had to
+*/
+int finished(Endpoint* endpoint) {
+    return (!endpoint->sends || endpoint->written == size) && (!endpoint->receives || endpoint->received == size);
+}
+
+/**
+ * Sends size bytes over a link (both ways with DUPLEX), both ends driven by this thread
+ * returns seconds taken, -1 if the transfer failed
+*/
+double transfer(double* busy, int* wakeups) {
+    Endpoint endpoints[2];
+    RelayedLink link;
+    if (openRelayedLink(&link, BAUD_RATE, ber) == -1) return -1;
+    memset(endpoints, 0, sizeof(endpoints));
+    for (int i = 0; i < 2; i++) {
+        strcpy(endpoints[i].port, link.ports[i]);
+        endpoints[i].role = i == 0 ? LlTx : LlRx;
+        endpoints[i].sends = i == 0 || DUPLEX;
+        endpoints[i].receives = i == 1 || DUPLEX;
+    }
+
+    pthread_t relayThread;
+    relaying = 1;
+    pthread_create(&relayThread, NULL, runRelay, &link);
+    double start = now();
+    bothEndpoints(openEndpoint, endpoints);
+    int failed = endpoints[0].conn == NULL || endpoints[1].conn == NULL;
+
+    // Event loop
+    int epollFd = epoll_create1(0);
+    for (int i = 0; !failed && i < 2; i++) {
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = &endpoints[i]};
+        int fd = ll_eventFd(endpoints[i].conn);
+        if (fd == -1 || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1 || submitRequests(&endpoints[i]) == -1) failed = 1;
+    }
+    double loopStart = threadTime();
+    *wakeups = 0;
+    while (!failed && !(finished(&endpoints[0]) && finished(&endpoints[1]))) {
+        struct epoll_event events[2];
+        int n = epoll_wait(epollFd, events, 2, 10000);
+        if (n <= 0) failed = 1; // Stalled
+        (*wakeups)++;
+        for (int i = 0; i < n && !failed; i++) {
+            Endpoint* endpoint = (Endpoint*)events[i].data.ptr;
+            if (ll_poll(endpoint->conn, 0) == -1 || endpoint->failed || submitRequests(endpoint) == -1) failed = 1;
+        }
+    }
+    *busy = threadTime() - loopStart;
+    close(epollFd);
+
+    // After a failure rx would wait for a DISC that may never come, only tx (which gives up after its retransmissions)
+    // is closed and the process exits with the connection of rx still open
+    if (!failed) bothEndpoints(closeEndpoint, endpoints);
+    else if (endpoints[0].conn != NULL) ll_close(endpoints[0].conn, FALSE);
+    double seconds = now() - start;
+    relaying = 0;
+    pthread_join(relayThread, NULL);
+    closeRelayedLink(&link);
+    return failed || endpoints[0].failed || endpoints[1].failed ? -1 : seconds;
+}
+
+int main(int argc, char** argv) {
+    size = argc > 1 ? atoi(argv[1]) : 100000;
+    ber = argc > 2 ? atof(argv[2]) : 0;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    printf("%d bytes %s at %d baud, BER %g, one thread\n", size, DUPLEX ? "each way" : "tx to rx", BAUD_RATE, ber);
+    double busy;
+    int wakeups;
+    double seconds = transfer(&busy, &wakeups);
+    if (seconds < 0) {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    printf("Transfer:     %.2f s\n", seconds);
+    printf("Event loop:   %d wakeups, busy %.3f s (%.1f%% of the transfer)\n", wakeups, busy, 100 * busy / seconds);
+    printf("PASSED\n");
+    return 0;
+}
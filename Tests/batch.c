@@ -0,0 +1,168 @@
+// Batched interface test.
+// Tx sends a buffer with llwriteBatch, every packet gathered from two buffers (a small header and the
+// rest), and rx takes the packets with llreadBatch and checks every byte. Each end runs in its own
+// process over a pair of pseudo terminals joined by a relay that paces each direction at the baud
+// rate (0 forwards as fast as it can) and can flip bits. The buffer is sent twice: to a reader that
+// calls llreadBatch as soon as it can, then to one that sleeps before every call, so the frames of the
+// window are already there and at least one call has to return more than one packet.
+// Build (from the repository root, with a CRC so bit errors cannot get through):
+//   gcc -O2 -W -DARQ_MODE=2 -DFCS_TYPE=FCS_CRC32C -o batch Tests/batch.c Tests/pty_relay.c Proj/src/*.c -IProj/include
+// Run:
+//   ./batch [size] [baud rate] [ber]
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "link_layer.h"
+#include "link_layer_ext.h"
+#include "pty_relay.h"
+
+#define LINK_BAUD_RATE 115200 // Given to the link layer (the relay sets the real pace)
+#define BATCH_SIZE 4          // Packets per llwriteBatch / llreadBatch
+#define HEADER_SIZE 4         // Bytes of the first buffer of every packet
+#define TIME_LIMIT 120        // Seconds before a stalled transfer is stopped
+#define RETRANSMISSIONS 10    // The first batches are sized before the link knows the line is noisy
+#define SLOW_READER_MS 200    // Sleep of the slow reader before every llreadBatch
+
+/**
+ * Opens the link of an end
+ * returns 0 on success
+ *        -1 on error
+*/
+int openEnd(const char* port, LinkLayerRole role) {
+    LinkLayer parameters;
+    strcpy(parameters.serialPort, port);
+    parameters.role = role;
+    parameters.baudRate = LINK_BAUD_RATE;
+    parameters.nRetransmissions = RETRANSMISSIONS;
+    parameters.timeout = 2;
+    return llopen(parameters) == 1 ? 0 : -1;
+}
+
+/**
+ * Sends size bytes, BATCH_SIZE packets per llwriteBatch
+ * returns 0 on success, 1 otherwise (exit status)
+*/
+int runTx(const char* port, int size) {
+    if (openEnd(port, LlTx) == -1) return 1;
+
+    unsigned char* data = (unsigned char*)malloc(size);
+    if (data == NULL) return 1;
+    for (int i = 0; i < size; i++) data[i] = pattern(0, i);
+
+    int sent = 0;
+    while (sent < size) {
+        struct iovec iov[2 * BATCH_SIZE];
+        int iovcnt[BATCH_SIZE];
+        int numPackets = 0;
+        int payloadSize = llpayloadSize();
+        for (; numPackets < BATCH_SIZE && sent < size; numPackets++) {
+            int n = payloadSize < size - sent ? payloadSize : size - sent;
+            int header = n < HEADER_SIZE ? n : HEADER_SIZE;
+            iov[2 * numPackets] = (struct iovec){data + sent, header};
+            iov[2 * numPackets + 1] = (struct iovec){data + sent + header, n - header};
+            iovcnt[numPackets] = 2;
+            sent += n;
+        }
+        if (llwriteBatch(iov, iovcnt, numPackets) != numPackets) {
+            printf("tx: llwriteBatch failed\n");
+            return 1;
+        }
+    }
+    free(data);
+    return llclose(FALSE) == 1 ? 0 : 1;
+}
+
+/**
+ * Receives size bytes, up to BATCH_SIZE packets per llreadBatch, and checks them
+ * readDelayMs - sleep before every llreadBatch (0 reads right away)
+ * returns 0 if they are the bytes tx sent (and, with a delay, a call returned several packets), 1 otherwise (exit status)
+*/
+int runRx(const char* port, int size, int readDelayMs) {
+    if (openEnd(port, LlRx) == -1) return 1;
+
+    static unsigned char buffers[BATCH_SIZE][MAX_PAYLOAD_SIZE];
+    unsigned char* packets[BATCH_SIZE];
+    for (int i = 0; i < BATCH_SIZE; i++) packets[i] = buffers[i];
+
+    int received = 0, batches = 0, packetsRead = 0, mostPackets = 0;
+    while (received < size) {
+        int sizes[BATCH_SIZE];
+        if (readDelayMs > 0) usleep(readDelayMs * 1000);
+        int numPackets = llreadBatch(packets, sizes, BATCH_SIZE);
+        if (numPackets < 1) {
+            printf("rx: llreadBatch failed\n");
+            return 1;
+        }
+        for (int p = 0; p < numPackets; p++) {
+            if (received + sizes[p] > size) {
+                printf("rx: %d bytes too many\n", received + sizes[p] - size);
+                return 1;
+            }
+            for (int i = 0; i < sizes[p]; i++) {
+                if (packets[p][i] != pattern(0, received + i)) {
+                    printf("rx: byte %d differs\n", received + i);
+                    return 1;
+                }
+            }
+            received += sizes[p];
+        }
+        batches++;
+        packetsRead += numPackets;
+        if (numPackets > mostPackets) mostPackets = numPackets;
+    }
+    printf("%d packets in %d llreadBatch calls, up to %d at once\n", packetsRead, batches, mostPackets);
+    if (readDelayMs > 0 && mostPackets < 2) {
+        printf("rx: no llreadBatch returned the packets that were already there\n");
+        return 1;
+    }
+    return llclose(FALSE) == 1 ? 0 : 1;
+}
+
+/**
+ * Sends size bytes from tx to rx over a new link
+ * readDelayMs - sleep of rx before every llreadBatch
+ * returns seconds taken, -1 if the transfer failed
+*/
+double transfer(int size, int baudRate, double ber, int readDelayMs) {
+    RelayedLink link;
+    if (openRelayedLink(&link, baudRate, ber) == -1) return -1;
+
+    double start = now();
+    pid_t pids[2];
+    for (int i = 0; i < 2; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            closeRelayedLink(&link);
+            exit(i == 0 ? runTx(link.ports[0], size) : runRx(link.ports[1], size, readDelayMs));
+        }
+    }
+    int ok = relayChildren(&link, 1, pids, 2, TIME_LIMIT, NULL, NULL);
+    double seconds = now() - start;
+    closeRelayedLink(&link);
+    return ok ? seconds : -1;
+}
+
+int main(int argc, char** argv) {
+    int size = argc > 1 ? atoi(argv[1]) : 50000;
+    int baudRate = argc > 2 ? atoi(argv[2]) : 115200;
+    double ber = argc > 3 ? atof(argv[3]) : 0;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    printf("%d bytes at %d baud, BER %g, %d packets per batch\n", size, baudRate, ber, BATCH_SIZE);
+    double seconds = transfer(size, baudRate, ber, 0);
+    double slowSeconds = seconds < 0 ? -1 : transfer(size, baudRate, ber, SLOW_READER_MS);
+    if (seconds < 0 || slowSeconds < 0) {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    printf("Transfer:    %.2f s (%.0f bytes/s)\n", seconds, size / seconds);
+    printf("Slow reader: %.2f s (sleeps %d ms before every llreadBatch)\n", slowSeconds, SLOW_READER_MS);
+    printf("PASSED\n");
+    return 0;
+}
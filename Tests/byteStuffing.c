@@ -1,44 +1,35 @@
+// Byte stuffing test and throughput benchmark.
+// Build (from the repository root):
+//   gcc -O2 -W -o byteStuffing Tests/byteStuffing.c Proj/src/byte_stuffing.c -IProj/include
+// Run:
+//   ./byteStuffing [payloadSize] [iterations]
+
 #include <stdio.h>
 #include <unistd.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-
+#include "byte_stuffing.h"
 
 // Frame Fields
-#define FLAG 0x7E
-
 #define ADDRESS_SENT_BY_TX 0x03 // or replies sent by receiver.
-#define ADDRESS_SENT_BY_RX 0x01 // or replies sent by transmitter.
-
-#define CONTROL_SET 0x03
-#define CONTROL_UA 0x07
 
-#define CONTROL_RR0 0xAA
-#define CONTROL_RR1 0xAB
-#define CONTROL_REJ0 0x54
-#define CONTROL_REJ1 0x55
-#define CONTROL_DISC 0x0B
-
-#define ESCAPE_OCTET 0x7D
-#define ESCAPE_XOR 0x20
-
-void ByteStuffer(unsigned char* buf, int bufSize) {
+/**
+ * Original llwrite stuffing (one pass to count, one pass to stuff, one pass for BCC2)
+ * Used as reference and as baseline for the benchmark.
+*/
+int ByteStuffer(const unsigned char* buf, int bufSize, unsigned char* frame) {
 
     int newFrameSize = bufSize + 6;
     for (int i = 0; i < bufSize; i++) { // Get the new frame size for byte stuffing
         if (buf[i] == FLAG || buf[i] == ESCAPE_OCTET) newFrameSize++;
     }
 
-    unsigned char* frame = (unsigned char*)malloc(sizeof(unsigned char) * (newFrameSize));
-
-    frame[0] = FLAG; 
+    frame[0] = FLAG;
     frame[1] = ADDRESS_SENT_BY_TX;
-
-   
-        frame[2] = 0x80;
-
-    
+    frame[2] = 0x80;
     frame[3] = frame[1] ^ frame[2];
 
     int j = 0;
@@ -56,34 +47,138 @@ void ByteStuffer(unsigned char* buf, int bufSize) {
     unsigned char BCC2 = buf[0];
 
     for (int j = 1; j < bufSize; j++) {
-        BCC2 ^= buf[j]; 
+        BCC2 ^= buf[j];
     }
 
     frame[newFrameSize - 2] = BCC2;
     frame[newFrameSize - 1] = FLAG;
+    return newFrameSize;
+}
 
-
-    printf("\n DEBUG: Now doing byte stuffing part.\n Before: ");
+/**
+ * Original llread destuffing (realloc for every output byte, separate BCC2 loop)
+ * Used as baseline for the benchmark.
+*/
+int ByteDestuffer(const unsigned char* buf, int bufSize, unsigned char* out, unsigned char* bcc2) {
+    unsigned char* actualData = (unsigned char*)malloc(sizeof(unsigned char));
+    int actualDataIt = 0;
     for (int i = 0; i < bufSize; i++) {
-        printf("%x ", buf[i]);
+        if (actualDataIt != 0) actualData = (unsigned char*)realloc(actualData, (actualDataIt + 1) * sizeof(unsigned char));
+        if (buf[i] != ESCAPE_OCTET) actualData[actualDataIt++] = buf[i];
+        else actualData[actualDataIt++] = buf[++i] ^ ESCAPE_XOR;
     }
 
+    unsigned char dataAccm = 0x00;
+    for (int i = 0; i < actualDataIt; i++) dataAccm ^= actualData[i];
 
-    printf("\n After Byte Stuffing: ");
-    for (int i = 0; i < newFrameSize; i++) {
-        printf("%x ", frame[i]);
-    }
-
-    printf("\n");
+    memcpy(out, actualData, actualDataIt);
+    free(actualData);
+    *bcc2 = dataAccm;
+    return actualDataIt;
+}
 
+double elapsed(struct timespec start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
 
+/**
+ * Checks the kernels against the original stuffing for a given input
+ * returns 0 on success
+ *        -1 on mismatch
+*/
+int check(const unsigned char* buf, int bufSize) {
+    unsigned char* reference = malloc(STUFFED_SIZE(bufSize) + 6);
+    unsigned char* stuffed = malloc(STUFFED_SIZE(bufSize));
+    unsigned char* destuffed = malloc(bufSize);
+    int referenceSize = ByteStuffer(buf, bufSize, reference);
+
+    unsigned char bcc2 = 0x00, bcc2Scalar = 0x00, bcc2Destuffed = 0x00;
+    int size = stuffBytes(buf, bufSize, stuffed, &bcc2);
+    int sizeScalar = stuffBytesScalar(buf, bufSize, stuffed, &bcc2Scalar);
+    int result = 0;
+
+    if (size != referenceSize - 6 || sizeScalar != size || memcmp(stuffed, reference + 4, size) != 0) result = -1;
+    if (bufSize > 0 && (bcc2 != reference[referenceSize - 2] || bcc2Scalar != bcc2)) result = -1;
+
+    stuffBytes(buf, bufSize, stuffed, &bcc2);
+    if (destuffBytes(stuffed, size, destuffed, &bcc2Destuffed) != bufSize || memcmp(destuffed, buf, bufSize) != 0 || bcc2Destuffed != bcc2) result = -1;
+
+    free(reference);
+    free(stuffed);
+    free(destuffed);
+    return result;
 }
 
-int main(){
+int main(int argc, char* argv[]){
+    int payloadSize = argc > 1 ? atoi(argv[1]) : 1000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 20000;
 
+    // Original example
     unsigned char abc[] = {0x7E, 0x7E, 0x10, 0x7D};
+    unsigned char example[16];
+    unsigned char bcc2;
+    int exampleSize = stuffBytes(abc, 4, example, &bcc2);
+    printf("Before: ");
+    for (int i = 0; i < 4; i++) printf("%x ", abc[i]);
+    printf("\nAfter Byte Stuffing: ");
+    for (int i = 0; i < exampleSize; i++) printf("%x ", example[i]);
+    printf("(BCC2 %x)\n", bcc2);
+
+    // Correctness: every size up to 300 bytes, random data with a growing share of special bytes
+    srand(1);
+    unsigned char* buf = malloc(payloadSize > 300 ? payloadSize : 300);
+    for (int size = 0; size <= 300; size++) {
+        for (int density = 0; density <= 100; density += 25) {
+            for (int i = 0; i < size; i++) {
+                int r = rand();
+                buf[i] = (r % 100) < density ? ((r >> 8) & 1 ? FLAG : ESCAPE_OCTET) : (unsigned char)(r >> 16);
+            }
+            if (check(buf, size) != 0) {
+                printf("Mismatch for size %d, density %d%%\n", size, density);
+                return 1;
+            }
+        }
+    }
+    printf("Kernels match the original byte stuffing (kernel: %s)\n", byteStuffingKernel());
+
+    // Throughput: random payload (about 1 in 128 bytes is special, as in a compressed file)
+    for (int i = 0; i < payloadSize; i++) buf[i] = (unsigned char)rand();
+    unsigned char* frame = malloc(STUFFED_SIZE(payloadSize) + 6);
+    unsigned char* out = malloc(STUFFED_SIZE(payloadSize));
+    double megabytes = (double)payloadSize * iterations / 1e6;
+    struct timespec start;
+    volatile unsigned char sink = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) sink ^= frame[ByteStuffer(buf, payloadSize, frame) - 2];
+    printf("stuff   original: %8.1f MB/s\n", megabytes / elapsed(start));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) { stuffBytesScalar(buf, payloadSize, out, &bcc2); sink ^= bcc2; }
+    printf("stuff   scalar:   %8.1f MB/s\n", megabytes / elapsed(start));
 
-    ByteStuffer(abc, 4);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) { stuffBytes(buf, payloadSize, out, &bcc2); sink ^= bcc2; }
+    printf("stuff   %-8s: %8.1f MB/s\n", byteStuffingKernel(), megabytes / elapsed(start));
+
+    int stuffedSize = stuffBytes(buf, payloadSize, frame, &bcc2);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) { ByteDestuffer(frame, stuffedSize, out, &bcc2); sink ^= bcc2; }
+    printf("destuff original: %8.1f MB/s\n", megabytes / elapsed(start));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) { destuffBytesScalar(frame, stuffedSize, out, &bcc2); sink ^= bcc2; }
+    printf("destuff scalar:   %8.1f MB/s\n", megabytes / elapsed(start));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) { destuffBytes(frame, stuffedSize, out, &bcc2); sink ^= bcc2; }
+    printf("destuff %-8s: %8.1f MB/s\n", byteStuffingKernel(), megabytes / elapsed(start));
+
+    free(buf);
+    free(frame);
+    free(out);
     return 0;
 }
-
@@ -0,0 +1,128 @@
+// Full-duplex transfer test and benchmark.
+// Two endpoints swap a buffer over a pair of pseudo terminals joined by a relay that paces every
+// direction at the baud rate (and can flip bits), first one direction after the other in the
+// same session, then both at once with the acknowledgements riding in the I frames.
+// Build (from the repository root):
+//   gcc -O2 -W -DARQ_MODE=1 -DDUPLEX=1 -o duplex Tests/duplex.c Tests/pty_relay.c Proj/src/*.c -IProj/include
+// Run:
+//   ./duplex [size] [ber]
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "link_layer.h"
+#include "link_layer_ext.h"
+#include "pty_relay.h"
+
+#define BAUD_RATE 115200
+
+static double ber = 0;
+
+/**
+ * Sends size bytes and receives as many, one direction after the other or both at once
+ * returns 0 if the bytes received are the ones the other end sent
+ *         1 otherwise
+*/
+int runEndpoint(const char* port, LinkLayerRole role, int size, int bothAtOnce) {
+    LinkLayer connection;
+    strcpy(connection.serialPort, port);
+    connection.role = role;
+    connection.baudRate = BAUD_RATE;
+    connection.nRetransmissions = 5;
+    connection.timeout = 2;
+    if (llopen(connection) == -1) return 1;
+
+    LinkLayerRole other = role == LlTx ? LlRx : LlTx;
+    unsigned char packet[MAX_PAYLOAD_SIZE];
+    int sent = 0, received = 0;
+    while (sent < size || received < size) {
+        // Sequential: tx sends first, rx answers once it has everything
+        int mayWrite = sent < size && (bothAtOnce || role == LlTx || received == size);
+
+        if (mayWrite) {
+            int n = llpayloadSize();
+            if (n > size - sent) n = size - sent;
+            for (int i = 0; i < n; i++) packet[i] = pattern(role, sent + i);
+            if (llwrite(packet, n) != n) return 1;
+            sent += n;
+        }
+        // While writing, only the packets that already arrived are read (all of them, the queue is small)
+        while (received < size && (bothAtOnce || role == LlRx || sent == size)) {
+            if (mayWrite && sent < size && llreadAvailable() <= 0) break;
+            int n = llread(packet);
+            if (n < 0 || received + n > size) return 1;
+            for (int i = 0; i < n; i++) {
+                if (packet[i] != pattern(other, received + i)) {
+                    printf("%s: byte %d differs\n", role == LlTx ? "tx" : "rx", received + i);
+                    return 1;
+                }
+            }
+            received += n;
+        }
+    }
+    return llclose(FALSE) == 1 ? 0 : 1;
+}
+
+/**
+ * Runs both endpoints and relays their bytes until they exit
+ * returns seconds taken, -1 if a transfer failed
+*/
+double swap(int size, int bothAtOnce) {
+    RelayedLink link;
+    if (openRelayedLink(&link, BAUD_RATE, ber) == -1) return -1;
+
+    double start = now();
+    pid_t pids[2];
+    for (int i = 0; i < 2; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            closeRelayedLink(&link);
+            exit(runEndpoint(link.ports[i], i == 0 ? LlTx : LlRx, size, bothAtOnce));
+        }
+    }
+
+    int running = 2, failed = 0;
+    double last = now();
+    while (running > 0) {
+        usleep(1000);
+        double t = now();
+        relayLink(&link, t - last);
+        last = t;
+
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = 1;
+        }
+    }
+    double seconds = now() - start;
+
+    closeRelayedLink(&link);
+    return failed ? -1 : seconds;
+}
+
+int main(int argc, char** argv) {
+    int size = argc > 1 ? atoi(argv[1]) : 50000;
+    ber = argc > 2 ? atof(argv[2]) : 0;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    printf("Swapping %d bytes each way at %d baud, BER %g\n", size, BAUD_RATE, ber);
+    double sequential = swap(size, FALSE);
+    double duplex = swap(size, TRUE);
+    if (sequential < 0 || duplex < 0) {
+        printf("FAILED (sequential %s, duplex %s)\n", sequential < 0 ? "failed" : "ok", duplex < 0 ? "failed" : "ok");
+        return 1;
+    }
+
+    double ideal = 2.0 * size * 10 / BAUD_RATE; // Both directions one after the other, data bytes only
+    printf("One direction after the other: %.2f s\n", sequential);
+    printf("Both directions at once:       %.2f s (%.2fx faster)\n", duplex, sequential / duplex);
+    printf("Data bytes alone take %.2f s one after the other, %.2f s at once\n", ideal, ideal / 2);
+    printf("PASSED\n");
+    return 0;
+}
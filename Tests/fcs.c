@@ -0,0 +1,155 @@
+// Frame check sequence test and throughput benchmark.
+// Build (from the repository root):
+//   gcc -O2 -W -o fcs Tests/fcs.c Proj/src/fcs.c -IProj/include
+// Run:
+//   ./fcs [payloadSize] [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fcs.h"
+
+/**
+ * Original llwrite BCC2 (XOR of the data, one byte at a time)
+ * Used as baseline for the benchmark.
+*/
+unsigned char BCC2(const unsigned char* buf, int bufSize) {
+    unsigned char BCC2 = buf[0];
+    for (int j = 1; j < bufSize; j++) {
+        BCC2 ^= buf[j];
+    }
+    return BCC2;
+}
+
+/**
+ * Bit at a time CRCs (reflected), used as reference
+*/
+unsigned short crc16Bitwise(const unsigned char* buf, int bufSize) {
+    unsigned short crc = 0xFFFF;
+    for (int i = 0; i < bufSize; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    }
+    return crc ^ 0xFFFF;
+}
+
+unsigned int crc32cBitwise(const unsigned char* buf, int bufSize) {
+    unsigned int crc = 0xFFFFFFFF;
+    for (int i = 0; i < bufSize; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+double elapsed(struct timespec start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/**
+ * Counts the frames with numErrors flipped bits that the FCS does not detect
+*/
+int undetectedErrors(FcsType type, unsigned char* buf, int bufSize, int numErrors, int frames) {
+    unsigned char fcs[FCS_MAX_SIZE], check[FCS_MAX_SIZE];
+    int undetected = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        for (int i = 0; i < bufSize; i++) buf[i] = (unsigned char)rand();
+        computeFcs(type, buf, bufSize, fcs);
+        for (int e = 0; e < numErrors; e++) {
+            int bit = rand() % (bufSize * 8);
+            buf[bit / 8] ^= 1 << (bit % 8);
+        }
+        computeFcs(type, buf, bufSize, check);
+        if (memcmp(fcs, check, fcsSize(type)) == 0) undetected++;
+    }
+    return undetected;
+}
+
+int main(int argc, char* argv[]){
+    int payloadSize = argc > 1 ? atoi(argv[1]) : 1000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200000;
+
+    // Check values of the CRC catalogue ("123456789")
+    const unsigned char check[] = "123456789";
+    printf("CRC-16/X-25 check: %04x (expected 906e)\n", crc16(check, 9));
+    printf("CRC-32C check: %08x (expected e3069283)\n", crc32c(check, 9));
+    if (crc16(check, 9) != 0x906E || crc32c(check, 9) != 0xE3069283 || crc32cSlicingBy8(check, 9) != 0xE3069283) {
+        printf("Check values do not match\n");
+        return 1;
+    }
+
+    // Correctness: every size up to 300 bytes against the bit at a time CRCs
+    srand(1);
+    unsigned char* buf = malloc(payloadSize > 300 ? payloadSize : 300);
+    for (int size = 0; size <= 300; size++) {
+        for (int i = 0; i < size; i++) buf[i] = (unsigned char)rand();
+        if (crc16(buf, size) != crc16Bitwise(buf, size) ||
+            crc32c(buf, size) != crc32cBitwise(buf, size) ||
+            crc32cSlicingBy8(buf, size) != crc32cBitwise(buf, size)) {
+            printf("Mismatch for size %d\n", size);
+            return 1;
+        }
+
+        // The same data split in two (computeFcsv continues the CRC over every buffer)
+        int split = size / 3;
+        if (crc16Update(crc16(buf, split), buf + split, size - split) != crc16Bitwise(buf, size) ||
+            crc32cUpdate(crc32c(buf, split), buf + split, size - split) != crc32cBitwise(buf, size)) {
+            printf("Mismatch for size %d split at %d\n", size, split);
+            return 1;
+        }
+    }
+    printf("Kernels match the bit at a time CRCs (kernel: %s)\n", crcKernel());
+
+    // Undetected errors: 1000 byte frames with an even number of flipped bits (BCC2 misses two flips in the same bit position)
+    printf("Undetected errors out of 100000 frames with 2 / 4 flipped bits in the same bit position:\n");
+    const char* names[] = {"BCC2", "CRC-16", "CRC-32C"};
+    for (int type = FCS_BCC2; type <= FCS_CRC32C; type++) {
+        int undetected[2];
+        for (int n = 0; n < 2; n++) {
+            undetected[n] = 0;
+            for (int frame = 0; frame < 100000; frame++) {
+                unsigned char fcs[FCS_MAX_SIZE], after[FCS_MAX_SIZE];
+                for (int i = 0; i < 1000; i++) buf[i] = (unsigned char)rand();
+                computeFcs(type, buf, 1000, fcs);
+                int bit = rand() % 8, first = rand() % 1000;
+                for (int e = 0; e < 2 * (n + 1); e++) buf[(first + e * (1 + rand() % 199)) % 1000] ^= 1 << bit;
+                computeFcs(type, buf, 1000, after);
+                if (memcmp(fcs, after, fcsSize(type)) == 0) undetected[n]++;
+            }
+        }
+        printf("  %-8s %6d / %6d (random 3 bit errors: %d)\n", names[type], undetected[0], undetected[1], undetectedErrors(type, buf, 1000, 3, 100000));
+    }
+
+    // Throughput
+    for (int i = 0; i < payloadSize; i++) buf[i] = (unsigned char)rand();
+    double megabytes = (double)payloadSize * iterations / 1e6;
+    struct timespec start;
+    volatile unsigned int sink = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) { buf[0] ^= sink; sink ^= BCC2(buf, payloadSize); }
+    printf("BCC2 original:        %8.1f MB/s\n", megabytes / elapsed(start));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations / 20; it++) sink ^= crc32cBitwise(buf, payloadSize);
+    printf("CRC-32C bitwise:      %8.1f MB/s\n", megabytes / 20 / elapsed(start));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) sink ^= crc16(buf, payloadSize);
+    printf("CRC-16 slicing-by-8:  %8.1f MB/s\n", megabytes / elapsed(start));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) sink ^= crc32cSlicingBy8(buf, payloadSize);
+    printf("CRC-32C slicing-by-8: %8.1f MB/s\n", megabytes / elapsed(start));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int it = 0; it < iterations; it++) sink ^= crc32c(buf, payloadSize);
+    printf("CRC-32C %-12s: %8.1f MB/s\n", crcKernel(), megabytes / elapsed(start));
+
+    free(buf);
+    return 0;
+}
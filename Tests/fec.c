@@ -0,0 +1,148 @@
+// Forward error correction test and goodput benchmark.
+// Build (from the repository root):
+//   gcc -O2 -W -o fec Tests/fec.c Proj/src/fec.c Proj/src/fcs.c -IProj/include -lm
+// Run:
+//   ./fec [transmissions]
+//
+// The goodput benchmark sends frames over a simulated cable (same noise model as cable.c:
+// each byte gets at most one wrong bit) and counts every byte put on the wire, including
+// retransmissions and RR/REJ frames. Byte stuffing is left out (same for both modes).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fec.h"
+#include "fcs.h"
+
+#define PAYLOAD_SIZE 1000
+#define HEADER_SIZE 5 // F A C BCC1 ... F
+#define SU_FRAME_SIZE 5
+
+/**
+ * Adds noise to buf, returns number of bytes changed
+*/
+int addNoise(unsigned char* buf, int bufSize, double byteErrorRate) {
+    int changed = 0;
+    for (int i = 0; i < bufSize; i++) {
+        if ((double)rand() / RAND_MAX < byteErrorRate) {
+            buf[i] ^= 1 << (rand() % 8);
+            changed++;
+        }
+    }
+    return changed;
+}
+
+/**
+ * Checks that every pattern of up to paritySize / 2 wrong bytes is corrected
+ * returns 0 on success
+ *        -1 on failure
+*/
+int check(int paritySize, int dataSize) {
+    unsigned char data[4096], encoded[4096];
+    for (int i = 0; i < dataSize; i++) data[i] = (unsigned char)rand();
+    memcpy(encoded, data, dataSize);
+    int size = dataSize + fecEncode(data, dataSize, paritySize, encoded + dataSize);
+    if (size != fecEncodedSize(dataSize, paritySize)) return -1;
+
+    // paritySize / 2 errors in every block (data and parity)
+    int numBlocks = (size + 254) / 255;
+    int blockData = 255 - paritySize;
+    for (int block = 0; block < numBlocks; block++) {
+        for (int e = 0; e < paritySize / 2; e++) {
+            int blockSize = dataSize - block * blockData < blockData ? dataSize - block * blockData : blockData;
+            int at = rand() % (blockSize + paritySize);
+            if (at < blockSize) encoded[block * blockData + at] ^= 1 + rand() % 255;
+            else encoded[dataSize + block * paritySize + at - blockSize] ^= 1 + rand() % 255;
+        }
+    }
+
+    int corrected;
+    if (fecDecode(encoded, size, paritySize, &corrected) != dataSize) return -1;
+    return memcmp(encoded, data, dataSize) == 0 ? 0 : -1;
+}
+
+/**
+ * Sends frames of PAYLOAD_SIZE bytes with stop and wait over a noisy cable
+ * (a fixed number of transmissions, frames that are not received are sent again)
+ * returns goodput (payload bytes delivered / bytes on the wire)
+*/
+double goodput(double ber, int paritySize, int transmissions, int* undetected) {
+    double byteErrorRate = 1 - pow(1 - ber, 8);
+    unsigned char data[PAYLOAD_SIZE + FCS_MAX_SIZE], frame[4096];
+    long wire = 0, delivered = 0;
+    int dataSize = PAYLOAD_SIZE + 4;
+    int newFrame = 1;
+    *undetected = 0;
+
+    for (int sent = 0; sent < transmissions; sent++) {
+        if (newFrame) {
+            for (int i = 0; i < PAYLOAD_SIZE; i++) data[i] = (unsigned char)rand();
+            computeFcs(FCS_CRC32C, data, PAYLOAD_SIZE, data + PAYLOAD_SIZE);
+        }
+
+        memcpy(frame, data, dataSize);
+        int size = dataSize;
+        if (paritySize > 0) size += fecEncode(data, dataSize, paritySize, frame + dataSize);
+        wire += size + HEADER_SIZE + SU_FRAME_SIZE;
+
+        // A damaged header or response costs a retransmission as well
+        unsigned char header[HEADER_SIZE + SU_FRAME_SIZE] = {0};
+        int headerErrors = addNoise(header, sizeof(header), byteErrorRate);
+        addNoise(frame, size, byteErrorRate);
+
+        int corrected;
+        int received = paritySize > 0 ? fecDecode(frame, size, paritySize, &corrected) : size;
+        unsigned char fcs[FCS_MAX_SIZE];
+        computeFcs(FCS_CRC32C, frame, PAYLOAD_SIZE, fcs);
+
+        newFrame = headerErrors == 0 && received == dataSize && memcmp(fcs, frame + PAYLOAD_SIZE, 4) == 0;
+        if (!newFrame) continue; // REJ or timeout
+        if (memcmp(frame, data, PAYLOAD_SIZE) != 0) (*undetected)++;
+        delivered += PAYLOAD_SIZE;
+    }
+    return (double)delivered / wire;
+}
+
+int main(int argc, char* argv[]){
+    int transmissions = argc > 1 ? atoi(argv[1]) : 2000;
+    srand(1);
+
+    // Correctness
+    int paritySizes[] = {2, 8, 16, 32, 64};
+    for (int p = 0; p < 5; p++) {
+        for (int size = 1; size <= 1100; size += 37) {
+            for (int it = 0; it < 20; it++) {
+                if (check(paritySizes[p], size) != 0) {
+                    printf("Correction failed for %d parity bytes, %d data bytes\n", paritySizes[p], size);
+                    return 1;
+                }
+            }
+        }
+    }
+    printf("Every block with up to parity / 2 wrong bytes was corrected\n");
+
+    // Goodput
+    double bers[] = {0, 1e-5, 5e-5, 1e-4, 2e-4, 5e-4, 1e-3, 2e-3};
+    int fecParity[] = {0, 4, 8, 16, 32};
+    printf("\nGoodput (payload / bytes on the wire), %d transmissions of %d byte frames, stop and wait, CRC-32C\n", transmissions, PAYLOAD_SIZE);
+    printf("%8s", "BER");
+    for (int p = 0; p < 5; p++) {
+        if (fecParity[p] == 0) printf(" %12s", "ARQ only");
+        else printf("   RS parity %2d", fecParity[p]);
+    }
+    printf("\n");
+    for (int b = 0; b < 8; b++) {
+        printf("%8g", bers[b]);
+        int undetectedTotal = 0;
+        for (int p = 0; p < 5; p++) {
+            int undetected;
+            double g = goodput(bers[b], fecParity[p], transmissions, &undetected);
+            printf(fecParity[p] == 0 ? " %12.3f" : " %14.3f", g);
+            undetectedTotal += undetected;
+        }
+        printf(undetectedTotal ? "   (%d undetected)\n" : "\n", undetectedTotal);
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+// Connection handle test and benchmark.
+// One process drives several links at once, one thread per endpoint, through the handles of
+// link_layer_ext.h. Every link is a pair of pseudo terminals joined by a relay that paces each
+// direction at the baud rate (and can flip bits). A single link runs first, then all of them
+// at once: with no state shared between connections both take about the same time.
+// Build (from the repository root):
+//   gcc -O2 -W -pthread -o multiLink Tests/multiLink.c Tests/pty_relay.c Proj/src/*.c -IProj/include
+// Run:
+//   ./multiLink [links] [size] [ber]
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "link_layer.h"
+#include "link_layer_ext.h"
+#include "pty_relay.h"
+
+#define BAUD_RATE 115200
+#define MAX_LINKS 8
+
+typedef struct {
+    char port[50];
+    LinkLayerRole role;
+    int link; // Every link sends its own bytes
+    int failed;
+} Endpoint;
+
+static double ber = 0;
+static int size = 50000;
+static volatile int running = 0; // Endpoints that did not finish yet
+
+/**
+ * Sends size bytes (tx) or receives them (rx) over its own connection
+*/
+void* runEndpoint(void* arg) {
+    Endpoint* endpoint = (Endpoint*)arg;
+    endpoint->failed = 1;
+
+    LinkLayer parameters;
+    strcpy(parameters.serialPort, endpoint->port);
+    parameters.role = endpoint->role;
+    parameters.baudRate = BAUD_RATE;
+    parameters.nRetransmissions = 5;
+    parameters.timeout = 2;
+    LinkConnection* conn = ll_open(parameters);
+    if (conn == NULL) {
+        __sync_fetch_and_sub(&running, 1);
+        return NULL;
+    }
+
+    unsigned char packet[MAX_PAYLOAD_SIZE];
+    int done = 0, ok = 1;
+    while (ok && done < size) {
+        if (endpoint->role == LlTx) {
+            int n = ll_payloadSize(conn);
+            if (n > size - done) n = size - done;
+            for (int i = 0; i < n; i++) packet[i] = pattern(endpoint->link, done + i);
+            if (ll_write(conn, packet, n) != n) ok = 0;
+            done += n;
+        } else {
+            int n = ll_read(conn, packet);
+            if (n < 0 || done + n > size) ok = 0;
+            for (int i = 0; ok && i < n; i++) {
+                if (packet[i] != pattern(endpoint->link, done + i)) {
+                    printf("link %d: byte %d differs\n", endpoint->link, done + i);
+                    ok = 0;
+                }
+            }
+            done += n;
+        }
+    }
+    if (ll_close(conn, FALSE) == 1 && ok) endpoint->failed = 0;
+    __sync_fetch_and_sub(&running, 1);
+    return NULL;
+}
+
+/**
+ * Runs the endpoints of numLinks links in this process and relays their bytes until they finish
+ * returns seconds taken, -1 if a transfer failed
+*/
+double transfer(int numLinks) {
+    RelayedLink links[MAX_LINKS];
+    Endpoint endpoints[2 * MAX_LINKS];
+    for (int i = 0; i < numLinks; i++) {
+        if (openRelayedLink(&links[i], BAUD_RATE, ber) == -1) return -1;
+        for (int end = 0; end < 2; end++) {
+            strcpy(endpoints[2 * i + end].port, links[i].ports[end]);
+            endpoints[2 * i + end].role = end == 0 ? LlTx : LlRx;
+            endpoints[2 * i + end].link = i;
+        }
+    }
+
+    double start = now();
+    pthread_t threads[2 * MAX_LINKS];
+    running = 2 * numLinks;
+    for (int i = 0; i < 2 * numLinks; i++) pthread_create(&threads[i], NULL, runEndpoint, &endpoints[i]);
+
+    double last = now();
+    while (running > 0) {
+        usleep(1000);
+        double t = now();
+        for (int i = 0; i < numLinks; i++) relayLink(&links[i], t - last);
+        last = t;
+    }
+    double seconds = now() - start;
+
+    int failed = 0;
+    for (int i = 0; i < 2 * numLinks; i++) {
+        pthread_join(threads[i], NULL);
+        failed |= endpoints[i].failed;
+    }
+    for (int i = 0; i < numLinks; i++) closeRelayedLink(&links[i]);
+    return failed ? -1 : seconds;
+}
+
+int main(int argc, char** argv) {
+    int numLinks = argc > 1 ? atoi(argv[1]) : 4;
+    size = argc > 2 ? atoi(argv[2]) : 50000;
+    ber = argc > 3 ? atof(argv[3]) : 0;
+    if (numLinks < 1 || numLinks > MAX_LINKS) numLinks = 4;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    printf("%d links, %d bytes each at %d baud, BER %g\n", numLinks, size, BAUD_RATE, ber);
+    double single = transfer(1);
+    double all = transfer(numLinks);
+    if (single < 0 || all < 0) {
+        printf("FAILED (one link %s, %d links %s)\n", single < 0 ? "failed" : "ok", numLinks, all < 0 ? "failed" : "ok");
+        return 1;
+    }
+
+    printf("One link:       %.2f s\n", single);
+    printf("%d links at once: %.2f s (%.2fx the bytes of one link per second)\n", numLinks, all, numLinks * single / all);
+    printf("PASSED\n");
+    return 0;
+}
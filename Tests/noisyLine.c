@@ -0,0 +1,88 @@
+// Noisy line test.
+// The application layer sends a file over a link that flips bits, several times, each time with other
+// bit errors (the relay's random numbers are seeded with the number of the run). Every copy must arrive
+// whole before TIME_LIMIT: a transfer that gives up after too many retransmissions or stalls fails.
+// This is where the timers of the ends meet (the retransmission timeout of tx against the delayed
+// acknowledgements, REJ and polls of rx), and the first frames go out at the largest payload before
+// tx has seen the line is noisy, so build it for Go-Back-N and for Selective Repeat.
+// Build (from the repository root, with a CRC so bit errors cannot get through):
+//   gcc -O2 -W -pthread -DARQ_MODE=1 -DFCS_TYPE=FCS_CRC32C -o noisyLine Tests/noisyLine.c Tests/pty_relay.c Proj/src/*.c -IProj/include
+//   gcc -O2 -W -pthread -DARQ_MODE=2 -DFCS_TYPE=FCS_CRC32C -o noisyLineSr Tests/noisyLine.c Tests/pty_relay.c Proj/src/*.c -IProj/include
+// Run:
+//   ./noisyLine [runs] [size] [ber] [baud rate]   (or ./noisyLineSr)
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include "application_layer.h"
+#include "pty_relay.h"
+
+#define LINK_BAUD_RATE 115200 // Given to the application (the relay sets the real pace)
+#define TIME_LIMIT 300        // Seconds before a stalled transfer is stopped
+#define RETRANSMISSIONS 5     // As the application is usually run
+#define TIMEOUT 2
+#define TX_FILE "/tmp/noisyLine-tx.bin"
+#define RX_FILE "/tmp/noisyLine-rx.bin"
+
+/**
+ * Sends TX_FILE to RX_FILE over one link
+ * returns seconds taken, -1 if the transfer failed
+*/
+double transfer(int baudRate, double ber) {
+    RelayedLink link;
+    if (openRelayedLink(&link, baudRate, ber) == -1) return -1;
+    unlink(RX_FILE);
+
+    double start = now();
+    pid_t pids[2];
+    for (int i = 0; i < 2; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            closeRelayedLink(&link);
+            freopen("/dev/null", "w", stdout);
+            applicationLayer(link.ports[i], i == 0 ? "tx" : "rx", LINK_BAUD_RATE, RETRANSMISSIONS, TIMEOUT, i == 0 ? TX_FILE : RX_FILE);
+            exit(0);
+        }
+    }
+    int ok = relayChildren(&link, 1, pids, 2, TIME_LIMIT, NULL, NULL);
+    double seconds = now() - start;
+    closeRelayedLink(&link);
+    return ok && sameFiles(TX_FILE, RX_FILE) ? seconds : -1;
+}
+
+int main(int argc, char** argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : 5;
+    int size = argc > 2 ? atoi(argv[2]) : 50000;
+    double ber = argc > 3 ? atof(argv[3]) : 1e-4;
+    int baudRate = argc > 4 ? atoi(argv[4]) : 115200;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    FILE* file = fopen(TX_FILE, "wb");
+    for (int i = 0; file != NULL && i < size; i++) fputc(pattern(0, i), file);
+    if (file == NULL || fclose(file) != 0) {
+        perror(TX_FILE);
+        return 1;
+    }
+
+    printf("%d transfers of %d bytes at %d baud, BER %g\n", runs, size, baudRate, ber);
+    int failed = 0;
+    for (int run = 1; run <= runs; run++) {
+        srand(run); // Other bit errors every run, the same ones every time the test runs
+        double seconds = transfer(baudRate, ber);
+        if (seconds < 0) {
+            printf("Run %2d:      FAILED\n", run);
+            failed++;
+        } else {
+            printf("Run %2d:      %.2f s (%.0f bytes/s)\n", run, seconds, size / seconds);
+        }
+    }
+
+    if (failed > 0) {
+        printf("FAILED (%d of %d runs)\n", failed, runs);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Paced pseudo terminal relay shared by the link tests.
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include "pty_relay.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+/**
+ * Seconds since an arbitrary start
+*/
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Byte i of a stream
+*/
+unsigned char pattern(int stream, int i) {
+    return (unsigned char)(i * 31 + (i >> 8) + stream * 101);
+}
+
+/**
+ * Opens a pseudo terminal in raw mode
+ * slaveName - room for 50 bytes
+ * returns the master file descriptor
+ *        -1 on error
+*/
+int openRawPty(char *slaveName) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) == -1 || unlockpt(master) == -1) return -1;
+    strncpy(slaveName, ptsname(master), 49);
+    slaveName[49] = '\0';
+
+    // No echo before the endpoint configures the port
+    int slave = open(slaveName, O_RDWR | O_NOCTTY);
+    if (slave < 0) return -1;
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    close(slave);
+
+    fcntl(master, F_SETFL, O_NONBLOCK);
+    return master;
+}
+
+/**
+ * Forwards the bytes a direction may send at its baud rate (all of them if it is 0), flipping bits with its ber
+*/
+void relay(Direction *direction, double elapsed) {
+    unsigned char buf[4096];
+    int maxBytes = sizeof(buf);
+    if (direction->baudRate > 0) {
+        direction->credit += elapsed * direction->baudRate / 10;
+        if (direction->credit > RELAY_CHUNK) direction->credit = RELAY_CHUNK;
+        if (direction->credit < 1) return;
+        maxBytes = (int)direction->credit;
+    }
+
+    int n = read(direction->from, buf, maxBytes);
+    if (n <= 0) return;
+    for (int i = 0; direction->ber > 0 && i < n; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            if (rand() < direction->ber * RAND_MAX) buf[i] ^= 1 << bit;
+        }
+    }
+    direction->credit -= n;
+    if (write(direction->to, buf, n) != n) perror("write");
+}
+
+int openRelayedLink(RelayedLink *link, int baudRate, double ber) {
+    for (int i = 0; i < 2; i++) {
+        link->masters[i] = openRawPty(link->ports[i]);
+        if (link->masters[i] < 0) {
+            perror("openRawPty");
+            if (i == 1) close(link->masters[0]);
+            return -1;
+        }
+    }
+    link->directions[0] = (Direction){link->masters[0], link->masters[1], 0, baudRate, ber};
+    link->directions[1] = (Direction){link->masters[1], link->masters[0], 0, baudRate, ber};
+    return 0;
+}
+
+void relayLink(RelayedLink *link, double elapsed) {
+    relay(&link->directions[0], elapsed);
+    relay(&link->directions[1], elapsed);
+}
+
+void closeRelayedLink(RelayedLink *link) {
+    close(link->masters[0]);
+    close(link->masters[1]);
+}
+
+int relayChildren(RelayedLink *links, int numLinks, const pid_t *pids, int numChildren, double limit,
+                  void (*idle)(void *arg, double t), void *arg) {
+    int running = numChildren, ok = 1;
+    double start = now(), last = start;
+    while (running > 0) {
+        usleep(links[0].directions[0].baudRate > 0 ? 1000 : 50);
+        double t = now();
+        for (int i = 0; i < numLinks; i++) relayLink(&links[i], t - last);
+        last = t;
+        if (idle != NULL) idle(arg, t);
+
+        int status;
+        while (running > 0 && waitpid(-1, &status, WNOHANG) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = 0;
+        }
+        if (running > 0 && t - start > limit) { // Stalled: an end waits for the other one forever
+            printf("Still running after %.0f s, stopped\n", limit);
+            for (int i = 0; i < numChildren; i++) kill(pids[i], SIGKILL);
+            while (running > 0 && waitpid(-1, NULL, 0) > 0) running--;
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+int sameFiles(const char *a, const char *b) {
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    int same = fa != NULL && fb != NULL;
+    while (same) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        if (ca != cb) same = 0;
+        if (ca == EOF) break;
+    }
+    if (fa != NULL) fclose(fa);
+    if (fb != NULL) fclose(fb);
+    return same;
+}
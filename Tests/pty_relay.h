@@ -0,0 +1,62 @@
+// Paced pseudo terminal relay shared by the link tests.
+// A test link is a pair of pseudo terminals, one per end. The test forwards the bytes written to one
+// master to the other at the baud rate (10 bits per byte, bursts of RELAY_CHUNK bytes at most), and
+// can flip bits with a given probability to stand in for a noisy line.
+// Built with the test (from the repository root):
+//   gcc ... Tests/<test>.c Tests/pty_relay.c Proj/src/*.c -IProj/include
+
+#ifndef _PTY_RELAY_H_
+#define _PTY_RELAY_H_
+
+#include <sys/types.h>
+
+#define RELAY_CHUNK 64 // Largest burst forwarded at once when paced (bytes)
+
+typedef struct {
+    int from;
+    int to;
+    double credit; // Bytes the direction may still forward
+    int baudRate;  // 0 forwards as fast as it can
+    double ber;    // Probability of flipping each bit
+} Direction;
+
+// Both ends of a link: the end on ports[0] sends through directions[0], the other one through directions[1].
+typedef struct {
+    char ports[2][50];
+    int masters[2];
+    Direction directions[2];
+} RelayedLink;
+
+// Seconds since an arbitrary start.
+double now();
+
+// Byte i of the stream a test sends (every sender of a test uses its own stream).
+unsigned char pattern(int stream, int i);
+
+// Open a pseudo terminal in raw mode, slaveName gets its path (room for 50 bytes).
+// Returns the master file descriptor (non-blocking), or -1 on error.
+int openRawPty(char *slaveName);
+
+// Forward the bytes a direction may send after elapsed more seconds, flipping bits with its ber.
+void relay(Direction *direction, double elapsed);
+
+// Open the pseudo terminals of a link, both directions at baudRate with the same ber.
+// Returns -1 on error, 0 otherwise.
+int openRelayedLink(RelayedLink *link, int baudRate, double ber);
+
+// Relay both directions of a link.
+void relayLink(RelayedLink *link, double elapsed);
+
+// Close the pseudo terminals of a link.
+void closeRelayedLink(RelayedLink *link);
+
+// Relay numLinks links until the numChildren processes in pids exit, calling idle (if not NULL) every round.
+// The ones still running after limit seconds are killed.
+// Return 1 if every process exited with status 0 in time, 0 otherwise.
+int relayChildren(RelayedLink *links, int numLinks, const pid_t *pids, int numChildren, double limit,
+                  void (*idle)(void *arg, double t), void *arg);
+
+// Return 1 if both files have the same contents, 0 otherwise.
+int sameFiles(const char *a, const char *b);
+
+#endif // _PTY_RELAY_H_
@@ -0,0 +1,89 @@
+// Striped transfer test and benchmark.
+// The application layer sends one file over several links at once when it is given a comma
+// separated list of serial ports. Every link is a pair of pseudo terminals joined by a relay that
+// paces each direction at the baud rate, and the first link can flip bits to stand in for a noisy
+// member. The file goes over one link first, then over all of them, and is compared every time.
+// A transfer still running after TIME_LIMIT seconds is stopped and fails.
+// Build (from the repository root, with a CRC so the noisy link cannot let errors through):
+//   gcc -O2 -W -pthread -DFCS_TYPE=FCS_CRC32C -o striping Tests/striping.c Tests/pty_relay.c Proj/src/*.c -IProj/include
+// Run:
+//   ./striping [links] [size] [ber of the first link]
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "application_layer.h"
+#include "pty_relay.h"
+
+#define BAUD_RATE 115200
+#define MAX_LINKS 8
+#define TIME_LIMIT 300 // Seconds before a stalled transfer is stopped
+#define TX_FILE "/tmp/striping-tx.bin"
+#define RX_FILE "/tmp/striping-rx.bin"
+
+/**
+ * Sends TX_FILE to RX_FILE striped over numLinks links, with ber on the first one
+ * returns seconds taken, -1 if the transfer failed
+*/
+double transfer(int numLinks, double ber) {
+    RelayedLink links[MAX_LINKS];
+    char ports[2][MAX_LINKS * 51] = {"", ""};
+    for (int i = 0; i < numLinks; i++) {
+        if (openRelayedLink(&links[i], BAUD_RATE, 0) == -1) return -1;
+        links[i].directions[0].ber = i == 0 ? ber : 0; // Only tx to rx on the first link
+        for (int end = 0; end < 2; end++) {
+            strcat(ports[end], links[i].ports[end]);
+            strcat(ports[end], ","); // Even a single link is striped
+        }
+    }
+    unlink(RX_FILE);
+
+    double start = now();
+    pid_t pids[2];
+    for (int i = 0; i < 2; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            for (int j = 0; j < numLinks; j++) closeRelayedLink(&links[j]);
+            freopen("/dev/null", "w", stdout);
+            applicationLayer(ports[i], i == 0 ? "tx" : "rx", BAUD_RATE, 5, 2, i == 0 ? TX_FILE : RX_FILE);
+            exit(0);
+        }
+    }
+
+    int ok = relayChildren(links, numLinks, pids, 2, TIME_LIMIT, NULL, NULL);
+    double seconds = now() - start;
+
+    for (int i = 0; i < numLinks; i++) closeRelayedLink(&links[i]);
+    return ok && sameFiles(TX_FILE, RX_FILE) ? seconds : -1;
+}
+
+int main(int argc, char** argv) {
+    int numLinks = argc > 1 ? atoi(argv[1]) : 4;
+    int size = argc > 2 ? atoi(argv[2]) : 100000;
+    double ber = argc > 3 ? atof(argv[3]) : 0;
+    if (numLinks < 1 || numLinks > MAX_LINKS) numLinks = 4;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    FILE* file = fopen(TX_FILE, "wb");
+    for (int i = 0; file != NULL && i < size; i++) fputc(pattern(0, i), file);
+    if (file == NULL || fclose(file) != 0) {
+        perror(TX_FILE);
+        return 1;
+    }
+
+    printf("%d bytes at %d baud over 1 and %d links, BER %g on the first link\n", size, BAUD_RATE, numLinks, ber);
+    double single = transfer(1, 0);
+    double striped = transfer(numLinks, ber);
+    if (single < 0 || striped < 0) {
+        printf("FAILED (one link %s, %d links %s)\n", single < 0 ? "failed" : "ok", numLinks, striped < 0 ? "failed" : "ok");
+        return 1;
+    }
+
+    printf("One link:    %.2f s\n", single);
+    printf("%d links:     %.2f s (%.2fx the goodput of one link)\n", numLinks, striped, single / striped);
+    printf("PASSED\n");
+    return 0;
+}
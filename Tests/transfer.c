@@ -0,0 +1,140 @@
+// Single link file transfer test and benchmark.
+// The application layer sends a file over one serial port, tx and rx in two processes. The link is
+// a pair of pseudo terminals joined by the relay of Tests/pty_relay.c, which paces each direction at
+// the baud rate (0 forwards as fast as it can, so the time the ends spend encoding and decoding frames
+// shows) and can flip bits. The received file is compared with the one sent, a transfer still running
+// after TIME_LIMIT seconds is stopped and fails. With a disk stall rx writes into a small pipe
+// instead of a file, and this process takes DISK_BLOCK bytes from it at a time, then nothing for
+// that many milliseconds after every STALL_EVERY blocks (a disk that flushes its cache now and then).
+// Build (from the repository root, with a CRC so bit errors cannot get through):
+//   gcc -O2 -W -pthread -DFCS_TYPE=FCS_CRC32C -o transfer Tests/transfer.c Tests/pty_relay.c Proj/src/*.c -IProj/include
+// Run:
+//   ./transfer [size] [baud rate] [ber] [disk stall ms]
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE // F_SETPIPE_SZ
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "application_layer.h"
+#include "pty_relay.h"
+
+#define LINK_BAUD_RATE 115200 // Given to the application (the relay sets the real pace)
+#define TIME_LIMIT 300        // Seconds before a stalled transfer is stopped
+#define TX_FILE "/tmp/transfer-tx.bin"
+#define RX_FILE "/tmp/transfer-rx.bin"
+#define DISK_FILE "/tmp/transfer-disk.bin" // What went through the pipe, with a disk stall
+#define DISK_BLOCK 4096                    // Bytes the disk takes at once (also the size of the pipe)
+#define STALL_EVERY 8                      // Blocks between stalls
+
+static int baudRate = 115200;
+static double ber = 0;
+static int diskStallMs = 0;
+
+typedef struct {
+    int pipe;     // Read end of RX_FILE
+    FILE* file;   // DISK_FILE
+    int blocks;
+    double freeAt; // When the disk takes the next block (seconds)
+} Disk;
+
+/**
+ * Takes a block from the pipe rx writes to, unless the disk is still stalled
+ * returns number of bytes taken
+*/
+int serveDisk(Disk* disk, double t) {
+    if (t < disk->freeAt) return 0;
+    unsigned char buf[DISK_BLOCK];
+    int n = read(disk->pipe, buf, sizeof(buf));
+    if (n <= 0) return 0;
+    fwrite(buf, 1, n, disk->file);
+    if (++disk->blocks % STALL_EVERY == 0) disk->freeAt = t + diskStallMs / 1000.0;
+    return n;
+}
+
+/**
+ * Serves the disk while the relay waits for the ends (relayChildren)
+*/
+void serveDiskWhileRelaying(void* arg, double t) {
+    Disk* disk = (Disk*)arg;
+    if (disk->pipe != -1) serveDisk(disk, t);
+}
+
+/**
+ * Sends TX_FILE to RX_FILE over one link
+ * returns seconds taken, -1 if the transfer failed
+*/
+double transfer() {
+    RelayedLink link;
+    if (openRelayedLink(&link, baudRate, ber) == -1) return -1;
+    unlink(RX_FILE);
+
+    // A slow disk: RX_FILE is a pipe that only takes DISK_BLOCK bytes at a time
+    Disk disk = {-1, NULL, 0, 0};
+    if (diskStallMs > 0) {
+        disk.file = fopen(DISK_FILE, "wb");
+        if (disk.file == NULL || mkfifo(RX_FILE, 0644) == -1 || (disk.pipe = open(RX_FILE, O_RDONLY | O_NONBLOCK)) == -1) {
+            perror(RX_FILE);
+            return -1;
+        }
+        fcntl(disk.pipe, F_SETPIPE_SZ, DISK_BLOCK);
+    }
+
+    double start = now();
+    pid_t pids[2];
+    for (int i = 0; i < 2; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            closeRelayedLink(&link);
+            if (disk.pipe != -1) close(disk.pipe);
+            freopen("/dev/null", "w", stdout);
+            applicationLayer(link.ports[i], i == 0 ? "tx" : "rx", LINK_BAUD_RATE, 5, 2, i == 0 ? TX_FILE : RX_FILE);
+            exit(0);
+        }
+    }
+
+    int ok = relayChildren(&link, 1, pids, 2, TIME_LIMIT, serveDiskWhileRelaying, &disk);
+    double seconds = now() - start;
+
+    closeRelayedLink(&link);
+    if (disk.pipe == -1) return ok && sameFiles(TX_FILE, RX_FILE) ? seconds : -1;
+
+    // What rx wrote last is still in the pipe
+    while (serveDisk(&disk, disk.freeAt) > 0);
+    close(disk.pipe);
+    fclose(disk.file);
+    unlink(RX_FILE);
+    return ok && sameFiles(TX_FILE, DISK_FILE) ? seconds : -1;
+}
+
+int main(int argc, char** argv) {
+    int size = argc > 1 ? atoi(argv[1]) : 100000;
+    baudRate = argc > 2 ? atoi(argv[2]) : 115200;
+    ber = argc > 3 ? atof(argv[3]) : 0;
+    diskStallMs = argc > 4 ? atoi(argv[4]) : 0;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    FILE* file = fopen(TX_FILE, "wb");
+    for (int i = 0; file != NULL && i < size; i++) fputc(pattern(0, i), file);
+    if (file == NULL || fclose(file) != 0) {
+        perror(TX_FILE);
+        return 1;
+    }
+
+    if (baudRate > 0) printf("%d bytes at %d baud, BER %g\n", size, baudRate, ber);
+    else printf("%d bytes, unpaced link, BER %g\n", size, ber);
+    if (diskStallMs > 0) printf("The disk of rx stalls %d ms after every %d bytes\n", diskStallMs, STALL_EVERY * DISK_BLOCK);
+    double seconds = transfer();
+    if (seconds < 0) {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    printf("Transfer:    %.2f s (%.0f bytes/s)\n", seconds, size / seconds);
+    printf("PASSED\n");
+    return 0;
+}